@@ -0,0 +1,190 @@
+"""Benchmark suite running both tools in every mode on generated formulas.
+
+For every family (see 'generate.py') and size the formula is generated
+once into the 'cnfs' directory and then checked by 'one_symmetry' and
+'two_symmetry' in all their modes.  Every run is recorded with its time,
+peak resident set size and the memory accounted by the tools (through
+'--stats-json') in a CSV file.  For every tool, mode and family the
+scaling exponents of time and memory in the number of literals are fitted
+and written to a second CSV file.  A mode which exceeded the timeout is
+skipped for larger sizes of the same family.
+
+  python bench.py [--sizes=1e3,1e4,...] [--families=php,...]
+                  [--timeout=<seconds>] [--output=<csv>]
+                  [--compare=<csv of an earlier build>]
+"""
+
+import csv
+import json
+import math
+import os
+import subprocess
+import sys
+import threading
+import time
+
+import generate
+
+FAMILIES = ['php', 'coloring', 'ksat', 'ksat-rearranged']
+
+ONE_SYMMETRY = '../one_symmetry/one_symmetry'
+ONE_MODES = ['', '--clauseswapping', '--sortclauses', '--sortliterals',
+             '--fixpoint']
+
+TWO_SYMMETRY = '../two_symmetry/two_symmetry'
+TWO_MODES = ['', '--sorting', '--groups', '--phase', '--lsh',
+             '--lsh --groups', '--rows', '--automorphisms']
+
+FIELDS = ['tool', 'mode', 'family', 'size', 'literals', 'variables',
+          'clauses', 'status', 'wall', 'cpu', 'rss_mb', 'memory_mb', 'checked', 'found']
+
+
+def formula(family, size):
+  path = f'cnfs/{family}-{size}.cnf'
+  if not os.path.exists(path):
+    os.makedirs('cnfs', exist_ok=True)
+    with open(path + '.tmp', 'w') as out:
+      generate.generate(family.split('-')[0], size, out,
+                        rearranged=family.endswith('-rearranged'))
+    os.rename(path + '.tmp', path)
+  with open(path) as cnf:
+    literals = int(cnf.readline().split()[1])
+    variables, clauses = map(int, cnf.readline().split()[2:4])
+  return path, variables, clauses, literals
+
+
+def run(binary, mode, path, timeout):
+  """Run a tool and return its status, wall-clock and process time, peak
+  resident set size and the JSON statistics record."""
+  stats = f'{path}.json'
+  if os.path.exists(stats):
+    os.unlink(stats)
+  start = time.monotonic()
+  process = subprocess.Popen([binary, '-q', '--stats-json', stats] +
+                             mode.split() + [path],
+                             stdout=subprocess.DEVNULL)
+  timer = threading.Timer(timeout, process.kill)
+  timer.start()
+  _, status, usage = os.wait4(process.pid, 0)
+  wall = time.monotonic() - start
+  timer.cancel()
+  process.returncode = status
+  record = {}
+  if os.path.exists(stats):
+    with open(stats) as records:
+      record = json.loads(records.readline())
+    os.unlink(stats)
+  if os.WIFSIGNALED(status) and wall >= timeout:
+    result = 'timeout'
+  elif os.WIFEXITED(status) and os.WEXITSTATUS(status) in (0, 10, 20):
+    result = 'ok'
+  else:
+    result = 'error'
+  # The tools report 'VmHWM', while 'ru_maxrss' also covers this
+  # interpreter, which the child was forked from.
+  rss = record.get('peak_rss_kb', usage.ru_maxrss) / 1024
+  return result, wall, usage.ru_utime + usage.ru_stime, rss, record
+
+
+def fit(points):
+  """Least squares slope of 'log y' over 'log x', ignoring points too small
+  to be measured reliably."""
+  points = [(math.log(x), math.log(y)) for x, y in points if y > 0.01]
+  if len(points) < 2:
+    return ''
+  mx = sum(x for x, _ in points) / len(points)
+  my = sum(y for _, y in points) / len(points)
+  sxx = sum((x - mx) ** 2 for x, _ in points)
+  if not sxx:
+    return ''
+  return '%.2f' % (sum((x - mx) * (y - my) for x, y in points) / sxx)
+
+
+def compare(rows, path):
+  old = {}
+  with open(path) as previous:
+    for row in csv.DictReader(previous):
+      if row['status'] == 'ok':
+        old[row['tool'], row['mode'], row['family'], row['size']] = row
+  print('%-13s %-16s %-16s %10s %9s %9s %7s' %
+        ('tool', 'mode', 'family', 'size', 'before', 'after', 'ratio'))
+  ratios = []
+  for row in rows:
+    key = (row['tool'], row['mode'], row['family'], str(row['size']))
+    if row['status'] != 'ok' or key not in old:
+      continue
+    before = float(old[key]['cpu'])
+    if before < 0.01 or row['cpu'] < 0.01:
+      continue
+    ratio = row['cpu'] / before
+    ratios.append(ratio)
+    print('%-13s %-16s %-16s %10s %8.3fs %8.3fs %6.2fx' %
+          (key + (before, row['cpu'], ratio)))
+  if ratios:
+    mean = math.exp(sum(map(math.log, ratios)) / len(ratios))
+    print(f'geometric mean of {len(ratios)} time ratios: {mean:.3f}x')
+
+
+if __name__ == '__main__':
+  options = {'sizes': '1e3,1e4,1e5,1e6', 'families': ','.join(FAMILIES),
+             'timeout': '60', 'output': 'bench.csv', 'compare': ''}
+  for arg in sys.argv[1:]:
+    name, _, value = arg.lstrip('-').partition('=')
+    if name not in options or not arg.startswith('--'):
+      sys.exit(__doc__)
+    options[name] = value
+  sizes = [int(float(size)) for size in options['sizes'].split(',')]
+  families = options['families'].split(',')
+  timeout = float(options['timeout'])
+
+  rows = []
+  tools = [('one_symmetry', ONE_SYMMETRY, ONE_MODES),
+           ('two_symmetry', TWO_SYMMETRY, TWO_MODES)]
+  for family in families:
+    timed_out = set()
+    for size in sizes:
+      path, variables, clauses, literals = formula(family, size)
+      for tool, binary, modes in tools:
+        for mode in modes:
+          row = {'tool': tool, 'mode': mode, 'family': family,
+                 'size': size, 'literals': literals, 'variables': variables,
+                 'clauses': clauses}
+          if (tool, mode) in timed_out:
+            row['status'] = 'skipped'
+          else:
+            status, wall, cpu, rss, record = run(binary, mode, path, timeout)
+            memory = sum(v for k, v in record.items()
+                         if k.endswith('_bytes')) / 1048576
+            row.update(status=status, wall=round(wall, 4), cpu=round(cpu, 4),
+                       rss_mb=round(rss, 1), memory_mb=round(memory, 3),
+                       checked=record.get('checked', ''),
+                       found=record.get('found', ''))
+            if status == 'timeout':
+              timed_out.add((tool, mode))
+          print(','.join(str(row.get(field, '')) for field in FIELDS),
+                flush=True)
+          rows.append(row)
+
+  with open(options['output'], 'w', newline='') as output:
+    writer = csv.DictWriter(output, FIELDS)
+    writer.writeheader()
+    writer.writerows(rows)
+
+  scaling = os.path.splitext(options['output'])[0] + '-scaling.csv'
+  with open(scaling, 'w', newline='') as output:
+    writer = csv.writer(output)
+    writer.writerow(['tool', 'mode', 'family', 'runs', 'time_exponent',
+                     'memory_exponent'])
+    for tool, _, modes in tools:
+      for mode in modes:
+        for family in families:
+          runs = [row for row in rows if row['tool'] == tool and
+                  row['mode'] == mode and row['family'] == family and
+                  row['status'] == 'ok']
+          writer.writerow([tool, mode, family, len(runs),
+                           fit([(r['literals'], r['cpu']) for r in runs]),
+                           fit([(r['literals'], r['memory_mb'])
+                                for r in runs])])
+
+  if options['compare']:
+    compare(rows, options['compare'])
@@ -0,0 +1,359 @@
+"""Differential tester of the fast engines against the reference engines.
+
+Small random and structured CNFs (with duplicate clauses, duplicate
+literals, planted symmetries and rearranged copies) are checked by both
+tools in all engine and option combinations:
+
+  * Exact engines have to report exactly the symmetries of their reference
+    mode (the straightforward quadratic 'check_symmetry').
+  * Lossy engines ('--lsh') may miss symmetries but not report others.
+  * Every reported symmetry, row swap and generator is also checked to map
+    the clause set to itself by an independent implementation here.
+  * If 'lib/libsymmetry.so' is built, the library (through the Python
+    bindings in 'lib/symmetry.py') has to report exactly the symmetries of
+    the tools in every mode it supports.
+
+The first disagreement is shrunk to a minimal CNF by removing clauses and
+literals and renumbering variables, which is then printed and written to
+'difftest-failure.cnf'.
+
+  python difftest.py [--rounds=<n>] [--seed=<n>] [--keep-going]
+"""
+
+import array
+import itertools
+import os
+import random
+import subprocess
+import sys
+import tempfile
+
+import generate
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+ONE_SYMMETRY = os.path.join(HERE, '../one_symmetry/one_symmetry')
+TWO_SYMMETRY = os.path.join(HERE, '../two_symmetry/two_symmetry')
+
+sys.path.insert(0, os.path.join(HERE, '../lib'))
+try:
+  import symmetry
+except (ImportError, OSError):  # Library not built.
+  symmetry = None
+
+# Pairs of reference mode and engine modes with the relation required
+# between their results ('exact' or 'subset').
+
+ONE_ENGINES = [
+    (reference, [f'{reference} {mode}'.strip() for mode in modes], 'exact')
+    for reference in ['', '--fixpoint']
+    for modes in [['--clauseswapping', '--sortclauses', '--sortliterals',
+                   '--sortclauses --sortliterals',
+                   '--clauseswapping --sortclauses',
+                   '--clauseswapping --sortliterals']]]
+
+TWO_ENGINES = [
+    (reference, [f'{reference} {mode}'.strip() for mode in modes], relation)
+    for reference in ['', '--phase']
+    for modes, relation in [
+        (['--sorting', '--groups', '--sorting --groups'], 'exact'),
+        (['--lsh', '--lsh --groups'], 'subset')]]
+
+# Modes only checked by the independent implementation.
+
+TWO_GENERATOR_MODES = ['--rows', '--automorphisms', '--rows --phase']
+
+# Options of the library for the command line options of the tools.
+
+ONE_LIBRARY_OPTIONS = {'--clauseswapping': 'clause_swapping',
+                       '--sortclauses': 'sort_clauses',
+                       '--sortliterals': 'sort_literals',
+                       '--fixpoint': 'fixpoint'}
+
+TWO_LIBRARY_OPTIONS = {'--sorting': 'sorting', '--groups': 'groups',
+                       '--phase': 'phase'}
+
+
+# Formulas are lists of clauses (lists of literals) with a variable count.
+
+def random_formula(rng):
+  variables = rng.randint(1, 8)
+  clauses = []
+  for _ in range(rng.randint(1, 16)):
+    size = rng.choice([1, 2, 2, 3, 3, 3, 4])
+    clause = [rng.randint(1, variables) * rng.choice([1, -1])
+              for _ in range(size)]
+    clauses.append(clause)
+  return variables, clauses
+
+
+def planted_formula(rng):
+  # Close random clauses under a negation and a transposition.
+  variables, clauses = random_formula(rng)
+  if variables < 2:
+    return variables, clauses
+  v = rng.randint(1, variables)
+  a, b = rng.sample(range(1, variables + 1), 2)
+  flip = lambda lit: -lit if abs(lit) == v else lit
+  swap = lambda lit: (b if lit > 0 else -b) if abs(lit) == a else \
+                     (a if lit > 0 else -a) if abs(lit) == b else lit
+  sign = rng.choice([1, -1])  # Phase shifted transposition if negative.
+  shift = lambda lit: lit if abs(lit) not in (a, b) else \
+                      sign * swap(lit)
+  closed = []
+  for clause in clauses:
+    images = [clause]
+    for mapping in rng.sample([flip, swap, shift], rng.randint(1, 2)):
+      images += [[mapping(lit) for lit in c] for c in images]
+    closed += images
+  return variables, closed
+
+
+def family_formula(rng):
+  family = rng.choice(generate.FAMILIES)
+  literals = rng.choice([20, 40, 80, 150])
+  rng_family = random.Random(rng.random())
+  variables, clauses = generate.formula(family, literals,
+                                        rng_family.randint(0, 99),
+                                        rng.random() < 0.5)
+  return variables, list(clauses)
+
+
+def mutate(variables, clauses, rng):
+  """Add duplicate clauses and literals and rearrange."""
+  clauses = [list(c) for c in clauses]
+  for _ in range(rng.randint(0, 2)):
+    if clauses:
+      duplicate = list(rng.choice(clauses))
+      rng.shuffle(duplicate)
+      clauses.append(duplicate)
+  for _ in range(rng.randint(0, 2)):
+    if clauses:
+      clause = rng.choice(clauses)
+      if clause:
+        clause.append(rng.choice(clause))
+  if rng.random() < 0.5:
+    for clause in clauses:
+      rng.shuffle(clause)
+    rng.shuffle(clauses)
+  return variables, clauses
+
+
+def formula_text(variables, clauses):
+  return f'p cnf {variables} {len(clauses)}\n' + ''.join(
+      ' '.join(map(str, clause)) + ' 0\n' for clause in clauses)
+
+
+def run(binary, mode, path):
+  result = subprocess.run([binary] + mode.split() + [path],
+                          stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                          timeout=60)
+  if result.returncode:
+    return None, result.stderr.decode(errors='replace').strip()
+  return result.stdout.decode(), ''
+
+
+# Results are sets of symmetries in a canonical form: variables negation
+# symmetric for 'one_symmetry', literal transpositions 'a <-> b' (where
+# 'a -> -b' is a phase shifted one) and general permutations for
+# 'two_symmetry'.
+
+def canonical_pair(a, b):
+  a, b = sorted((a, b), key=abs)
+  return (a, b) if a > 0 else (-a, -b)
+
+
+def one_results(output):
+  return {int(line.split()[-1]) for line in output.splitlines()
+          if line.startswith('c found symmetry on ')}
+
+
+# Interchangeable literals are closed transitively, since groups imply the
+# transpositions of all their members, which single pairs only generate.
+
+def closure(pairs):
+  parent = {}
+  def find(lit):
+    parent.setdefault(lit, lit)
+    while parent[lit] != lit:
+      lit = parent[lit]
+    return lit
+  for a, b in pairs:
+    for x, y in ((a, b), (-a, -b)):
+      parent[find(x)] = find(y)
+  classes = {}
+  for lit in list(parent):
+    classes.setdefault(find(lit), []).append(lit)
+  return {canonical_pair(a, b) for members in classes.values()
+          for a, b in itertools.combinations(members, 2) if a != -b}
+
+
+def two_results(output):
+  pairs, permutations = set(), []
+  for line in output.splitlines():
+    if line.startswith('found symmetry: '):
+      group = list(map(int, line.split(':')[1].split()))
+      for a, b in itertools.combinations(group, 2):
+        pairs.add(canonical_pair(a, b))
+    elif line.startswith(('found row symmetry: ', 'found generator: ')):
+      mapping = {}
+      for cycle in line.split(':')[1].split(')'):
+        cycle = list(map(int, cycle.replace('(', ' ').split()))
+        for lit, image in zip(cycle, cycle[1:] + cycle[:1]):
+          mapping[lit], mapping[-lit] = image, -image
+      permutations.append(mapping)
+  return closure(pairs), permutations
+
+
+def is_symmetry(clauses, mapping):
+  clause_set = {frozenset(clause) for clause in clauses}
+  return all(frozenset(mapping.get(lit, lit) for lit in clause) in clause_set
+             for clause in clause_set)
+
+
+def transposition(a, b):
+  return {a: b, b: a, -a: -b, -b: -a}
+
+
+def check(variables, clauses):
+  """Return a description of the first disagreement or 'None'."""
+  with tempfile.NamedTemporaryFile('w', suffix='.cnf', delete=False) as cnf:
+    cnf.write(formula_text(variables, clauses))
+  try:
+    return check_file(cnf.name, clauses)
+  finally:
+    os.unlink(cnf.name)
+
+
+def check_library(path, clauses):
+  literals = array.array('i', [lit for clause in clauses
+                               for lit in clause + [0]])
+  context = symmetry.Context(literals)
+  for tool, binary, engines, table in [
+      ('one_symmetry', ONE_SYMMETRY, ONE_ENGINES, ONE_LIBRARY_OPTIONS),
+      ('two_symmetry', TWO_SYMMETRY, TWO_ENGINES, TWO_LIBRARY_OPTIONS)]:
+    modes = {mode for reference, others, _ in engines
+             for mode in [reference] + others}
+    for mode in sorted(modes):
+      if any(option not in table for option in mode.split()):
+        continue
+      options = {table[option]: True for option in mode.split()}
+      output, error = run(binary, mode, path)
+      if output is None:
+        return f"{tool} '{mode}' failed: {error}"
+      if tool == 'one_symmetry':
+        expected = one_results(output)
+        found = set(context.negation_symmetries(**options))
+      else:
+        expected = two_results(output)[0]
+        found = closure(canonical_pair(a, b)
+                        for group in symmetry.groups(
+                            context.transpositions(**options))
+                        for a, b in itertools.combinations(group, 2))
+      if found != expected:
+        return (f"library '{mode}' reports {sorted(found)} "
+                f"but {tool} reports {sorted(expected)}")
+  return None
+
+
+def check_file(path, clauses):
+  for tool, binary, engines, results in [
+      ('one_symmetry', ONE_SYMMETRY, ONE_ENGINES, one_results),
+      ('two_symmetry', TWO_SYMMETRY, TWO_ENGINES,
+       lambda output: two_results(output)[0])]:
+    for reference, modes, relation in engines:
+      output, error = run(binary, reference, path)
+      if output is None:
+        return f"{tool} '{reference}' failed: {error}"
+      expected = results(output)
+      if tool == 'one_symmetry' and reference != '--fixpoint':
+        for var in expected:
+          if not is_symmetry(clauses, {var: -var, -var: var}):
+            return f"{tool} '{reference}' reports non-symmetry {var}"
+      if tool == 'two_symmetry':
+        for pair in expected:
+          if not is_symmetry(clauses, transposition(*pair)):
+            return f"{tool} '{reference}' reports non-symmetry {pair}"
+      for mode in modes:
+        output, error = run(binary, mode, path)
+        if output is None:
+          return f"{tool} '{mode}' failed: {error}"
+        found = results(output)
+        if found != expected and (relation == 'exact' or
+                                  not found <= expected):
+          return (f"{tool} '{mode}' reports {sorted(found)} "
+                  f"but '{reference}' reports {sorted(expected)}")
+  for mode in TWO_GENERATOR_MODES:
+    output, error = run(TWO_SYMMETRY, mode, path)
+    if output is None:
+      return f"two_symmetry '{mode}' failed: {error}"
+    for mapping in two_results(output)[1]:
+      if not is_symmetry(clauses, mapping):
+        return f"two_symmetry '{mode}' reports non-symmetry {mapping}"
+  if symmetry:
+    return check_library(path, clauses)
+  return None
+
+
+def shrink(variables, clauses, failure):
+  """Greedily remove clause chunks, single literals and unused variables
+  as long as some disagreement remains."""
+  fails = lambda cs: check(max([abs(l) for c in cs for l in c] + [1]), cs)
+  changed = True
+  while changed:
+    changed = False
+    chunk = max(1, len(clauses) // 2)
+    while chunk:
+      i = 0
+      while i < len(clauses):
+        candidate = clauses[:i] + clauses[i + chunk:]
+        if candidate and fails(candidate):
+          clauses, changed = candidate, True
+        else:
+          i += chunk
+      chunk //= 2
+    for i, clause in enumerate(clauses):
+      for j in range(len(clause)):
+        candidate = clauses[:i] + [clause[:j] + clause[j + 1:]] + \
+                    clauses[i + 1:]
+        if fails(candidate):
+          clauses, changed = candidate, True
+          break
+    used = sorted({abs(lit) for clause in clauses for lit in clause})
+    rename = {var: i + 1 for i, var in enumerate(used)}
+    renamed = [[rename[abs(lit)] * (1 if lit > 0 else -1) for lit in clause]
+               for clause in clauses]
+    if renamed != clauses and fails(renamed):
+      clauses, changed = renamed, True
+  variables = max([abs(lit) for c in clauses for lit in c] + [1])
+  return variables, clauses, check(variables, clauses) or failure
+
+
+if __name__ == '__main__':
+  rounds, seed, keep_going = 200, 0, False
+  for arg in sys.argv[1:]:
+    if arg.startswith('--rounds='):
+      rounds = int(arg[9:])
+    elif arg.startswith('--seed='):
+      seed = int(arg[7:])
+    elif arg == '--keep-going':
+      keep_going = True
+    else:
+      sys.exit(__doc__)
+  rng = random.Random(seed)
+  failures = 0
+  for round in range(rounds):
+    make = rng.choice([random_formula, planted_formula, family_formula])
+    variables, clauses = mutate(*make(rng), rng)
+    failure = check(variables, clauses)
+    if not failure:
+      continue
+    failures += 1
+    variables, clauses, failure = shrink(variables, clauses, failure)
+    print(f'round {round}: {failure}')
+    print(formula_text(variables, clauses), end='')
+    with open('difftest-failure.cnf', 'w') as out:
+      out.write(formula_text(variables, clauses))
+    if not keep_going:
+      sys.exit(1)
+  print(f'{rounds} rounds, {failures} failures')
+  sys.exit(1 if failures else 0)
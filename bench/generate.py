@@ -0,0 +1,156 @@
+"""Generator of synthetic CNFs with known symmetries for benchmarking.
+
+Every family is scaled to roughly a requested number of literals:
+
+  php       pigeon hole formulas (interchangeable pigeons and holes)
+  coloring  random graph coloring (interchangeable colors)
+  ksat      random 3-SAT with planted negation symmetric variables and
+            planted groups of interchangeable variables
+
+With '--rearrange' variables are renamed and clauses and literals shuffled,
+which keeps the symmetries but hides them from order based heuristics.
+
+  python generate.py <family> <literals> [--seed=<n>] [--rearrange]
+"""
+
+import random
+import sys
+
+FAMILIES = ['php', 'coloring', 'ksat']
+
+
+# Every family returns the number of variables and a generator of the
+# clauses, so even the largest formulas are written without storing them.
+
+def php(literals, rng):
+  # 'n' holes and 'n + 1' pigeons, about 'n^3' literals.
+  n = max(2, round(literals ** (1 / 3)))
+  var = lambda p, h: p * n + h + 1
+
+  def clauses():
+    for p in range(n + 1):
+      yield [var(p, h) for h in range(n)]
+    for h in range(n):
+      for p in range(n + 1):
+        for q in range(p + 1, n + 1):
+          yield [-var(p, h), -var(q, h)]
+  return n * (n + 1), clauses()
+
+
+def coloring(literals, rng):
+  # Four colors, average degree four, about 32 literals per vertex.
+  k = 4
+  vertices = max(4, literals // 32)
+  var = lambda v, c: v * k + c + 1
+
+  def clauses():
+    for v in range(vertices):
+      yield [var(v, c) for c in range(k)]
+      for c in range(k):
+        for d in range(c + 1, k):
+          yield [-var(v, c), -var(v, d)]
+    for _ in range(2 * vertices):
+      v, w = rng.sample(range(vertices), 2)
+      for c in range(k):
+        yield [-var(v, c), -var(w, c)]
+  return vertices * k, clauses()
+
+
+def ksat(literals, rng):
+  # Every 20th variable is negation symmetric (each of its clauses occurs
+  # in both phases) and a fifth of the variables form groups of four
+  # interchangeable variables (each clause with a group member occurs
+  # with every member of the group).  A clause has at most one of each.
+  n = max(20, literals // 15)
+  negated = set(range(1, n + 1, 20))
+  rest = [v for v in range(1, n + 1) if v not in negated]
+  group = {}
+  members = rest[:len(rest) // 5 // 4 * 4]
+  for i in range(0, len(members), 4):
+    for v in members[i:i + 4]:
+      group[v] = members[i:i + 4]
+
+  def clauses():
+    generated = 0
+    while generated < literals:
+      clause = []
+      has_negated = has_group = False
+      while len(clause) < 3:
+        v = rng.randint(1, n)
+        if v in negated and has_negated or v in group and has_group:
+          continue
+        if v in clause or -v in clause:
+          continue
+        has_negated |= v in negated
+        has_group |= v in group
+        clause.append(v if rng.random() < 0.5 else -v)
+      images = [clause]
+      for i, lit in enumerate(clause):
+        v = abs(lit)
+        if v in group:
+          images = [c[:i] + [w if lit > 0 else -w] + c[i + 1:]
+                    for c in images for w in group[v]]
+      for i, lit in enumerate(clause):
+        if abs(lit) in negated:
+          images += [c[:i] + [-c[i]] + c[i + 1:] for c in images]
+      yield from images
+      generated += 3 * len(images)
+  return n, clauses()
+
+
+# Shuffling the clauses needs all of them in memory, which limits the size
+# of rearranged copies.
+
+def rearrange(variables, clauses, rng):
+  clauses = list(clauses)
+  names = list(range(1, variables + 1))
+  rng.shuffle(names)
+  rename = lambda lit: names[lit - 1] if lit > 0 else -names[-lit - 1]
+  clauses = [[rename(lit) for lit in clause] for clause in clauses]
+  for clause in clauses:
+    rng.shuffle(clause)
+  rng.shuffle(clauses)
+  return variables, iter(clauses)
+
+
+def formula(family, literals, seed, rearranged):
+  rng = random.Random(f'{family} {literals} {seed}')
+  variables, clauses = globals()[family](literals, rng)
+  if rearranged:
+    return rearrange(variables, clauses, rng)
+  return variables, clauses
+
+
+def generate(family, literals, out, seed=0, rearranged=False):
+  """Write the formula to the stream 'out' and return its size as tuple
+  of variables, clauses and literals."""
+
+  # The header needs the number of clauses, thus the clauses are generated
+  # twice from the same seed, first only to count them.
+
+  count = written = 0
+  for clause in formula(family, literals, seed, rearranged)[1]:
+    count += 1
+    written += len(clause)
+  variables, clauses = formula(family, literals, seed, rearranged)
+  out.write(f'c {written} literals\np cnf {variables} {count}\n')
+  chunk = []
+  for clause in clauses:
+    chunk.append(' '.join(map(str, clause)) + ' 0\n')
+    if len(chunk) == 65536:
+      out.write(''.join(chunk))
+      chunk = []
+  out.write(''.join(chunk))
+  return variables, count, written
+
+
+if __name__ == '__main__':
+  args = [arg for arg in sys.argv[1:] if not arg.startswith('--')]
+  if len(args) != 2 or args[0] not in FAMILIES:
+    sys.exit(__doc__)
+  seed = 0
+  for arg in sys.argv[1:]:
+    if arg.startswith('--seed='):
+      seed = int(arg[7:])
+  generate(args[0], int(float(args[1])), sys.stdout, seed,
+           '--rearrange' in sys.argv)
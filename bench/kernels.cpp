@@ -0,0 +1,291 @@
+// Micro benchmark of the clause comparison kernels in 'common/kernels.hpp'.
+//
+// Clause pairs are generated with a given number of literals, a given
+// probability that the pair matches (otherwise a single literal differs)
+// and a given literal order of the second clause.  Every kernel is run on
+// a small working set repeated until it is cached ('warm') and on a large
+// working set, accessed in random order after evicting the caches
+// ('cold').  The kernels reorder the second clause, which is thus restored
+// before every comparison.  The time of restoring alone is measured too
+// and subtracted.
+
+#include <algorithm>
+#include <climits>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "../common/kernels.hpp"
+
+// Same layout as the clauses of 'two_symmetry'.
+
+struct Clause
+{
+  size_t id;
+  unsigned size;
+  int literals[];
+};
+
+static int size = 8;            // Literals per clause.
+static double match = 0.5;      // Probability of matching pairs.
+static const char *order = "same"; // Literal order of second clause.
+static int warm_kb = 16;        // Working set of warm runs.
+static int cold_mb = 256;       // Working set of cold runs.
+static double seconds = 0.5;    // Minimum time per warm measurement.
+
+static const char *usage =
+    "usage: kernels [ <option> ... ]\n"
+    "\n"
+    "where '<option>' is one of the following\n"
+    "\n"
+    "  -h | --help           print this command line option summary\n"
+    "  --size=<n>            literals per clause (default 8)\n"
+    "  --match=<percent>     percentage of matching pairs (default 50)\n"
+    "  --order=<order>       order of second clause 'same', 'shuffled'\n"
+    "                        or 'sorted' (default 'same')\n"
+    "  --warm-kb=<n>         warm working set in KB (default 16)\n"
+    "  --cold-mb=<n>         cold working set in MB (default 256)\n"
+    "  --ms=<n>              minimum time per measurement (default 500)\n"
+    "  --seed=<n>            random seed (default 0)\n";
+
+static void die(const char *fmt, ...)
+{
+  fprintf(stderr, "kernels: error: ");
+  va_list ap;
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+  fputc('\n', stderr);
+  exit(1);
+}
+
+static bool parse_int_option(const char *arg, const char *name, int *res,
+                             int min)
+{
+  size_t len = strlen(name);
+  if (strncmp(arg, name, len) || arg[len] != '=')
+    return false;
+  char *end;
+  long val = strtol(arg + len + 1, &end, 10);
+  if (end == arg + len + 1 || *end || val < min || val > INT_MAX)
+    die("invalid value in '%s'", arg);
+  *res = val;
+  return true;
+}
+
+// Negation kernels compare 'C var' with 'C -var', the transposition kernel
+// 'C var1' with 'C var2'.
+
+enum Kind
+{
+  NEGATION,
+  TRANSPOSITION
+};
+
+struct Pair
+{
+  Clause *c1, *c2;
+  const int *original; // Literals of 'c2' before comparing.
+  int var1, var2;
+};
+
+struct Kernel
+{
+  const char *name;
+  Kind kind;
+  bool (*compare)(const Pair &);
+};
+
+static const Kernel kernels[] = {
+    {"negation", NEGATION,
+     [](const Pair &p) { return negation_kernel(p.c1, p.c2, p.var1); }},
+    {"sorted_negation", NEGATION,
+     [](const Pair &p)
+     { return sorted_negation_kernel(p.c1, p.c2, p.var1); }},
+    {"transposition", TRANSPOSITION,
+     [](const Pair &p)
+     { return transposition_kernel(p.c1, p.c2, p.var1, p.var2); }},
+};
+
+// All clauses and original literals are allocated in one arena.
+
+static std::vector<char> arena;
+static size_t arena_used;
+
+static void *allocate(size_t bytes)
+{
+  bytes = (bytes + alignof(Clause) - 1) & ~(alignof(Clause) - 1);
+  void *res = arena.data() + arena_used;
+  arena_used += bytes;
+  return res;
+}
+
+static Clause *new_clause(const std::vector<int> &literals)
+{
+  Clause *c = (Clause *)allocate(sizeof(Clause) + size * sizeof(int));
+  c->id = 0;
+  c->size = size;
+  std::copy(literals.begin(), literals.end(), c->literals);
+  return c;
+}
+
+static size_t pair_bytes(void)
+{
+  return 3 * (sizeof(Clause) + size * sizeof(int));
+}
+
+static std::vector<Pair> generate_pairs(Kind kind, size_t n, std::mt19937 &rng)
+{
+  const int variables = 1 << 20;
+  arena.assign(n * pair_bytes(), 0);
+  arena_used = 0;
+  std::vector<Pair> pairs(n);
+  std::vector<int> c1, c2;
+  auto by_variable = [](int a, int b) { return abs(a) < abs(b); };
+  for (auto &pair : pairs)
+  {
+    c1.clear();
+    while ((int)c1.size() < size)
+    {
+      int lit = rng() % variables + 1;
+      if (rng() & 1)
+        lit = -lit;
+      bool fresh = true;
+      for (auto other : c1)
+        fresh &= abs(other) != abs(lit);
+      if (fresh)
+        c1.push_back(lit);
+    }
+    int pivot = rng() % size;
+    pair.var1 = c1[pivot] = abs(c1[pivot]);
+    pair.var2 = kind == NEGATION ? 0 : variables + 1;
+    c2 = c1;
+    c2[pivot] = kind == NEGATION ? -pair.var1 : pair.var2;
+    if (rng() % 1000000 >= match * 1000000 && size > 1)
+    {
+      int other = (pivot + 1 + rng() % (size - 1)) % size;
+      c2[other] = c2[other] < 0 ? variables + 2 : -variables - 2;
+    }
+    if (!strcmp(order, "shuffled"))
+      std::shuffle(c2.begin(), c2.end(), rng);
+    else if (!strcmp(order, "sorted"))
+    {
+      std::sort(c1.begin(), c1.end(), by_variable);
+      std::sort(c2.begin(), c2.end(), by_variable);
+    }
+    pair.c1 = new_clause(c1);
+    pair.c2 = new_clause(c2);
+    pair.original = new_clause(c2)->literals;
+  }
+  return pairs;
+}
+
+static double now(void) { return trace_clock() * 1e3; } // Nanoseconds.
+
+static void evict_caches(void)
+{
+  static std::vector<char> buffer(64 << 20);
+  for (size_t i = 0; i < buffer.size(); i += 64)
+    buffer[i]++;
+}
+
+// Run 'rounds' passes over the pairs and return the nanoseconds of all
+// comparisons (or of restoring only) and the number of matches.
+
+static double run(const std::vector<Pair> &pairs, const Kernel *kernel,
+                  size_t rounds, bool cold, size_t &matched)
+{
+  double time = 0;
+  matched = 0;
+  const size_t bytes = size * sizeof(int);
+  for (size_t r = 0; r < rounds; r++)
+  {
+    if (cold)
+      evict_caches();
+    double start = now();
+    for (auto &pair : pairs)
+    {
+      memcpy(pair.c2->literals, pair.original, bytes);
+      if (kernel)
+        matched += kernel->compare(pair);
+    }
+    time += now() - start;
+  }
+  return time;
+}
+
+static void measure(const Kernel &kernel, bool cold, std::mt19937 &rng)
+{
+  size_t n = (cold ? (size_t)cold_mb << 20 : (size_t)warm_kb << 10) /
+             pair_bytes();
+  n = std::max(n, (size_t)1);
+  std::vector<Pair> pairs = generate_pairs(kernel.kind, n, rng);
+  if (cold)
+    std::shuffle(pairs.begin(), pairs.end(), rng);
+
+  // Calibrate the number of rounds to the minimum time (cold runs only
+  // need a few, since every round is long and evicting is expensive).
+
+  size_t rounds = 1, matched;
+  stats = Statistics();
+  run(pairs, &kernel, 1, cold, matched);
+  if (cold)
+    rounds = 3;
+  else
+    while (run(pairs, &kernel, rounds, false, matched) < seconds * 1e9)
+      rounds *= 2;
+
+  stats = Statistics();
+  double total = run(pairs, &kernel, rounds, cold, matched);
+  uint64_t literal_comparisons = stats.literal_comparisons;
+  size_t ignored;
+  double restore = run(pairs, 0, rounds, cold, ignored);
+  double compares = (double)rounds * pairs.size();
+  double ns = std::max(total - restore, 0.0) / compares;
+  printf("%-16s %-5s %10zu %9.2f %12.0f %8.1f%% %9.2f\n", kernel.name,
+         cold ? "cold" : "warm", pairs.size(), ns, ns ? 1e9 / ns : 0.0,
+         100.0 * matched / compares, literal_comparisons / compares);
+}
+
+int main(int argc, char **argv)
+{
+  int percent = 50, ms = 500, seed_value = 0;
+  for (int i = 1; i != argc; i++)
+  {
+    const char *arg = argv[i];
+    if (!strcmp(arg, "-h") || !strcmp(arg, "--help"))
+    {
+      fputs(usage, stdout);
+      return 0;
+    }
+    else if (parse_int_option(arg, "--size", &size, 1) ||
+             parse_int_option(arg, "--match", &percent, 0) ||
+             parse_int_option(arg, "--warm-kb", &warm_kb, 1) ||
+             parse_int_option(arg, "--cold-mb", &cold_mb, 1) ||
+             parse_int_option(arg, "--ms", &ms, 1) ||
+             parse_int_option(arg, "--seed", &seed_value, 0))
+      continue;
+    else if (!strncmp(arg, "--order=", 8) &&
+             (!strcmp(arg + 8, "same") || !strcmp(arg + 8, "shuffled") ||
+              !strcmp(arg + 8, "sorted")))
+      order = arg + 8;
+    else
+      die("invalid option '%s' (try '-h')", arg);
+  }
+  if (percent > 100)
+    die("match percentage above 100");
+  match = percent / 100.0;
+  seconds = ms / 1e3;
+
+  printf("size %d, %d%% matching, order '%s'\n\n", size, percent, order);
+  printf("%-16s %-5s %10s %9s %12s %9s %9s\n", "kernel", "cache", "pairs",
+         "ns/cmp", "cmp/s", "matched", "lits/cmp");
+  std::mt19937 rng(seed_value);
+  for (auto &kernel : kernels)
+    for (bool cold : {false, true})
+      measure(kernel, cold, rng);
+  return 0;
+}
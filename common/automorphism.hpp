@@ -0,0 +1,501 @@
+// Automorphism search of 'two_symmetry' on a 'Transposition_search'.
+//
+// The search runs on the colored graph with one vertex per literal and
+// one per clause.  Literals are connected to their negation and to the
+// clauses they occur in, thus automorphisms are exactly the literal
+// permutations (including phase shifts) mapping the formula onto itself.
+// The graph is not built explicitly but read from the occurrence lists and
+// clauses of the formula.
+//
+// The search follows the first path approach of 'nauty'.  The partition of
+// the vertices is refined to an equitable one, then the first vertex of
+// the first non-singleton cell is individualized and refinement continues
+// until the partition is discrete (the first leaf).  For every level from
+// the bottom up and every other vertex of the target cell which is not
+// known to be in the same orbit, a leaf with the same refinement trace is
+// searched and checked for being an automorphism.  Splits are undone
+// instead of copying partitions, so the cost of a search node is
+// proportional to the part of the graph touched by refinement.
+
+#ifndef _automorphism_hpp_INCLUDED
+#define _automorphism_hpp_INCLUDED
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "formula.hpp"
+#include "stats.hpp"
+#include "transposition.hpp"
+
+struct Level
+{
+  int target;             // Start of the target cell.
+  int vertex;             // Vertex individualized on the first path.
+  uint64_t trace;         // Refinement trace after individualization.
+  size_t mark;            // Number of splits before individualization.
+  std::vector<int> cell;  // Members of the target cell.
+};
+
+static inline int literal_vertex(int lit)
+{
+  return lit > 0 ? 2 * (lit - 1) : 2 * (-lit - 1) + 1;
+}
+
+static inline int vertex_literal(int vertex)
+{
+  return vertex & 1 ? -(vertex / 2 + 1) : vertex / 2 + 1;
+}
+
+static inline Clause *vertex_clause(const Transposition_search &s, int vertex)
+{
+  return s.formula->clauses[vertex - 2 * s.formula->variables];
+}
+
+template <class F>
+static inline void for_each_neighbor(const Transposition_search &s,
+                                     int vertex, F f)
+{
+  const int variables = s.formula->variables;
+  if (vertex < 2 * variables)
+  {
+    f(vertex ^ 1);
+    for (auto c : s.formula->matrix[vertex_literal(vertex)])
+      f(2 * variables + c->id);
+  }
+  else
+  {
+    for (auto lit : *vertex_clause(s, vertex))
+      f(literal_vertex(lit));
+  }
+}
+
+// Cut the cell starting at 'parent' at position 'start'.
+
+static inline void cut_cell(Transposition_search &s, int parent, int start)
+{
+  auto &cell_end = s.cell_end;
+  s.splits.push_back({parent, start, cell_end[parent]});
+  cell_end[start] = cell_end[parent];
+  cell_end[parent] = start;
+  for (int p = start; p < cell_end[start]; p++)
+    s.cell_of[s.lab[p]] = start;
+  s.cells++;
+}
+
+static inline void undo_splits(Transposition_search &s, size_t mark)
+{
+  auto &splits = s.splits;
+  while (splits.size() > mark)
+  {
+    Split split = splits.back();
+    splits.pop_back();
+    for (int p = split.start; p < s.cell_end[split.start]; p++)
+      s.cell_of[s.lab[p]] = split.parent;
+    s.cell_end[split.parent] = split.end;
+    s.cells--;
+  }
+}
+
+static inline void queue_splitter(Transposition_search &s, int start)
+{
+  if (!s.queued[start])
+  {
+    s.queued[start] = true;
+    s.splitters.push_back(start);
+  }
+}
+
+// Split the cell starting at 'start' by the adjacency counts of the
+// touched vertices 'touched[l..r)' which are sorted by count.  Untouched
+// vertices (count zero) stay in front.  As in Hopcroft's algorithm all new
+// pieces but the largest become splitters unless the cell is queued
+// already.  Only positions and counts enter the trace, which thus does not
+// depend on the names of vertices.
+
+static inline uint64_t split_cell(Transposition_search &s, int start,
+                                  const std::vector<int> &touched, size_t l,
+                                  size_t r, uint64_t trace)
+{
+  auto &lab = s.lab, &lab_pos = s.lab_pos;
+  auto &cell_end = s.cell_end, &counts = s.counts;
+  int end = cell_end[start];
+  int size = end - start;
+  if (size == 1 || ((size_t)size == r - l && counts[touched[l]] ==
+                                               counts[touched[r - 1]]))
+    return trace;
+
+  // move touched vertices to the end of the cell in order of their counts
+  int p = end - (int)(r - l);
+  for (size_t i = l; i < r; i++, p++)
+  {
+    int vertex = touched[i];
+    int q = lab_pos[vertex];
+    std::swap(lab[p], lab[q]);
+    lab_pos[lab[q]] = q;
+    lab_pos[vertex] = p;
+  }
+
+  static thread_local std::vector<int> pieces;
+  pieces.clear();
+  if (end - (int)(r - l) > start)
+    pieces.push_back(start);
+  for (size_t i = l; i < r; i++)
+  {
+    if (i == l || counts[touched[i]] != counts[touched[i - 1]])
+    {
+      int piece = end - (int)(r - i);
+      pieces.push_back(piece);
+      trace = mix_hash(trace ^ ((uint64_t)piece << 32 | counts[touched[i]]));
+    }
+  }
+  for (size_t i = pieces.size() - 1; i > 0; i--)
+    cut_cell(s, start, pieces[i]);
+  trace = mix_hash(trace ^ start);
+
+  size_t largest = 0;
+  for (size_t i = 1; i < pieces.size(); i++)
+  {
+    if (cell_end[pieces[i]] - pieces[i] >
+        cell_end[pieces[largest]] - pieces[largest])
+      largest = i;
+  }
+  bool all = s.queued[start];
+  for (size_t i = 0; i < pieces.size(); i++)
+  {
+    if (all || i != largest)
+      queue_splitter(s, pieces[i]);
+  }
+  return trace;
+}
+
+static inline uint64_t refine(Transposition_search &s)
+{
+  auto &splitters = s.splitters;
+  auto &cell_of = s.cell_of, &counts = s.counts;
+  uint64_t trace = s.cells;
+  std::vector<int> touched;
+  size_t next = 0;
+  while (next < splitters.size())
+  {
+    int splitter = splitters[next++];
+    s.queued[splitter] = false;
+    for (int p = splitter; p < s.cell_end[splitter]; p++)
+    {
+      for_each_neighbor(s, s.lab[p], [&](int vertex)
+                        { if (!counts[vertex]++) touched.push_back(vertex); });
+    }
+    std::sort(touched.begin(), touched.end(), [&](int i, int j)
+              { return cell_of[i] < cell_of[j] ||
+                       (cell_of[i] == cell_of[j] && counts[i] < counts[j]); });
+    for (size_t l = 0, r; l < touched.size(); l = r)
+    {
+      for (r = l + 1;
+           r < touched.size() && cell_of[touched[r]] == cell_of[touched[l]];
+           r++)
+        ;
+      trace = split_cell(s, cell_of[touched[l]], touched, l, r, trace);
+    }
+    for (auto vertex : touched)
+      counts[vertex] = 0;
+    touched.clear();
+  }
+  splitters.clear();
+  return trace;
+}
+
+static inline uint64_t individualize(Transposition_search &s, int vertex)
+{
+  auto &lab = s.lab, &lab_pos = s.lab_pos;
+  int start = s.cell_of[vertex];
+  int q = lab_pos[vertex];
+  std::swap(lab[start], lab[q]);
+  lab_pos[lab[q]] = q;
+  lab_pos[vertex] = start;
+  cut_cell(s, start, start + 1);
+  queue_splitter(s, start);
+  return mix_hash(refine(s) ^ start);
+}
+
+static inline int first_target_cell(const Transposition_search &s)
+{
+  for (int p = 0; p < s.aut_vertices; p = s.cell_end[p])
+  {
+    if (s.cell_end[p] - p > 1)
+      return p;
+  }
+  return -1;
+}
+
+static inline int find_orbit(Transposition_search &s, int vertex)
+{
+  auto &orbit = s.orbit;
+  while (orbit[vertex] != vertex)
+  {
+    orbit[vertex] = orbit[orbit[vertex]];
+    vertex = orbit[vertex];
+  }
+  return vertex;
+}
+
+// Check whether mapping the first leaf to the current discrete partition
+// is an automorphism.  Only vertices in non-singleton cells of the level
+// the search started from can be moved.
+
+static inline bool check_leaf(Transposition_search &s,
+                              const std::vector<int> &free)
+{
+  const auto &lab = s.lab, &leaf_pos = s.leaf_pos;
+  const int variables = s.formula->variables;
+  std::vector<int> generator;
+  for (auto vertex : free)
+  {
+    if (vertex >= 2 * variables || (vertex & 1))
+      continue;
+    int image = lab[leaf_pos[vertex]];
+    if (image == vertex)
+      continue;
+    if (image >= 2 * variables || lab[leaf_pos[vertex ^ 1]] != (image ^ 1))
+      return false;
+    generator.push_back(vertex_literal(vertex));
+    generator.push_back(vertex_literal(image));
+  }
+
+  std::vector<std::pair<int, int>> pairs;
+  for (size_t i = 0; i < generator.size(); i += 2)
+    pairs.push_back({generator[i], generator[i + 1]});
+  std::sort(pairs.begin(), pairs.end());
+  generator.clear();
+  for (auto pair : pairs)
+  {
+    generator.push_back(pair.first);
+    generator.push_back(pair.second);
+  }
+
+  std::vector<Clause *> moved;
+  for (auto vertex : free)
+  {
+    if (vertex >= 2 * variables)
+      moved.push_back(vertex_clause(s, vertex));
+  }
+  for (size_t i = 0; i < generator.size(); i += 2)
+  {
+    for (int lit : {generator[i], -generator[i]})
+    {
+      auto &occs = s.formula->matrix[lit];
+      moved.insert(moved.end(), occs.begin(), occs.end());
+    }
+  }
+  std::sort(moved.begin(), moved.end());
+  moved.erase(std::unique(moved.begin(), moved.end()), moved.end());
+
+  set_permutation(s, generator);
+  bool res = true;
+  for (auto c : moved)
+  {
+    int vertex = 2 * variables + c->id;
+    int image = lab[leaf_pos[vertex]];
+    if (image < 2 * variables ||
+        !check_clause_permutation(s, c, vertex_clause(s, image)))
+    {
+      res = false;
+      break;
+    }
+  }
+  reset_permutation(s, generator);
+  if (!res)
+    return false;
+
+  for (auto vertex : free)
+  {
+    int image = lab[leaf_pos[vertex]];
+    s.orbit[find_orbit(s, image)] = find_orbit(s, vertex);
+  }
+  if (!generator.empty())
+    found_generator(s, s.aut_generators, generator);
+  return true;
+}
+
+static inline bool aut_limit_reached(Transposition_search &s)
+{
+  const int node_limit = s.options->aut_node_limit;
+  const int time_limit = s.options->aut_time_limit;
+  if (s.aut_incomplete)
+    return true;
+  if (!(s.aut_nodes & 255) && out_of_time(s))
+    s.aut_incomplete = true;
+  else if (node_limit && s.aut_nodes >= (size_t)node_limit)
+    s.aut_incomplete = true;
+  else if (time_limit && !(s.aut_nodes & 255) &&
+           thread_time() - s.aut_start_time >= time_limit)
+    s.aut_incomplete = true;
+  return s.aut_incomplete;
+}
+
+// Search a leaf equivalent to the first one below individualizing 'vertex'
+// instead of the first path vertex at level 'k'.
+
+static inline bool search_automorphism(Transposition_search &s,
+                                       std::vector<Level> &levels, size_t k,
+                                       int vertex,
+                                       const std::vector<int> &free)
+{
+  struct Frame
+  {
+    size_t level;
+    std::vector<int> candidates;
+    size_t next;
+    size_t mark;
+  };
+  std::vector<Frame> stack;
+  stack.push_back({k, {vertex}, 0, levels[k].mark});
+  while (!stack.empty())
+  {
+    Frame &frame = stack.back();
+    Level &level = levels[frame.level];
+    if (frame.next == frame.candidates.size())
+    {
+      stack.pop_back();
+      continue;
+    }
+    int candidate = frame.candidates[frame.next++];
+    undo_splits(s, frame.mark);
+    s.aut_nodes++;
+    if (aut_limit_reached(s))
+      return false;
+    if (individualize(s, candidate) != level.trace)
+      continue;
+    size_t next = frame.level + 1;
+    int target = first_target_cell(s);
+    if (next == levels.size())
+    {
+      if (target < 0 && check_leaf(s, free))
+        return true;
+      continue;
+    }
+    Level &next_level = levels[next];
+    if (target != next_level.target ||
+        s.cell_end[target] - target != (int)next_level.cell.size())
+      continue;
+    std::vector<int> candidates(s.lab.begin() + target,
+                                s.lab.begin() + s.cell_end[target]);
+    std::sort(candidates.begin(), candidates.end());
+    stack.push_back({next, candidates, 0, s.splits.size()});
+  }
+  return false;
+}
+
+static inline void find_automorphisms(Transposition_search &s)
+{
+  Phase_scope scope(CHECK);
+  auto matrix = s.formula->matrix;
+  const int variables = s.formula->variables;
+  const size_t clauses = s.formula->clauses.size();
+  auto &lab = s.lab, &cell_of = s.cell_of, &cell_end = s.cell_end;
+  s.aut_start_time = thread_time();
+  const int vertices = s.aut_vertices = 2 * variables + clauses;
+  lab.resize(vertices);
+  s.lab_pos.resize(vertices);
+  s.leaf_pos.resize(vertices);
+  cell_of.resize(vertices);
+  cell_end.resize(vertices);
+  s.counts.assign(vertices, 0);
+  s.queued.assign(vertices, false);
+  s.orbit.resize(vertices);
+
+  // Initial coloring: literals of occurring variables, then clauses, and
+  // literals of unused variables as singletons which are never moved.
+
+  int p = 0;
+  for (int var = 1; var <= variables; var++)
+  {
+    if (matrix[var].size() || matrix[-var].size())
+    {
+      lab[p++] = literal_vertex(var);
+      lab[p++] = literal_vertex(-var);
+    }
+  }
+  int literal_cells = p;
+  for (size_t i = 0; i < clauses; i++)
+    lab[p++] = 2 * variables + i;
+  int clause_cells = p;
+  for (int var = 1; var <= variables; var++)
+  {
+    if (!matrix[var].size() && !matrix[-var].size())
+    {
+      lab[p++] = literal_vertex(var);
+      lab[p++] = literal_vertex(-var);
+    }
+  }
+  s.cells = 0;
+  for (int start = 0, end; start < vertices; start = end)
+  {
+    if (start < literal_cells)
+      end = literal_cells;
+    else if (start < clause_cells)
+      end = clause_cells;
+    else
+      end = start + 1;
+    for (int q = start; q < end; q++)
+      cell_of[lab[q]] = start;
+    cell_end[start] = end;
+    s.cells++;
+    queue_splitter(s, start);
+  }
+  for (int q = 0; q < vertices; q++)
+  {
+    s.lab_pos[lab[q]] = q;
+    s.orbit[q] = q;
+  }
+  refine(s);
+
+  // First path down to the first leaf.
+
+  std::vector<Level> levels;
+  for (int target; (target = first_target_cell(s)) >= 0;)
+  {
+    Level level;
+    level.target = target;
+    level.cell.assign(lab.begin() + target, lab.begin() + cell_end[target]);
+    std::sort(level.cell.begin(), level.cell.end());
+    level.vertex = level.cell[0];
+    level.mark = s.splits.size();
+    level.trace = individualize(s, level.vertex);
+    levels.push_back(level);
+  }
+  for (int q = 0; q < vertices; q++)
+    s.leaf_pos[lab[q]] = q;
+  s.aut_depth = levels.size();
+
+  for (size_t k = levels.size(); !s.aut_incomplete && k-- > 0;)
+  {
+    Level &level = levels[k];
+    undo_splits(s, level.mark);
+    std::vector<int> free;
+    for (int q = 0; q < vertices; q = cell_end[q])
+    {
+      if (cell_end[q] - q > 1)
+        free.insert(free.end(), lab.begin() + q, lab.begin() + cell_end[q]);
+    }
+    std::vector<int> failed;
+    for (auto vertex : level.cell)
+    {
+      if (find_orbit(s, vertex) == find_orbit(s, level.vertex))
+        continue;
+      bool known = false;
+      for (auto other : failed)
+        known = known || find_orbit(s, vertex) == find_orbit(s, other);
+      if (known)
+        continue;
+      if (!search_automorphism(s, levels, k, vertex, free))
+      {
+        if (s.aut_incomplete)
+          break;
+        failed.push_back(vertex);
+      }
+      undo_splits(s, level.mark);
+    }
+  }
+}
+
+#endif
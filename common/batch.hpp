@@ -0,0 +1,115 @@
+// Batch mode shared by 'one_symmetry' and 'two_symmetry'.
+//
+// The CNFs to process are read from list files (one path per line, '-'
+// for standard input) or directories (all '*.cnf' files sorted).  A pool
+// of worker threads takes the next unprocessed instance until all are
+// taken.  The per-instance state of the tools is thread local and only
+// cleared between two instances, thus every worker reuses its memory.
+//
+// Workers keep the output of an instance in their own writer and write it
+// at once while holding 'output_lock' when the instance ends (see
+// 'output.hpp'), thus outputs of different instances are never interleaved
+// and workers only wait for each other while writing.
+
+#ifndef _batch_hpp_INCLUDED
+#define _batch_hpp_INCLUDED
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "output.hpp"
+
+struct Batch
+{
+  std::vector<std::string> files;
+  std::atomic<size_t> next;
+  std::atomic<size_t> failed;
+  std::mutex output_lock;
+};
+
+// Add the files of a list file or directory.  Returns zero on success and
+// otherwise what failed on 'path' (e.g., "access").
+
+static inline const char *collect_batch_files(Batch &b, const char *path)
+{
+  struct stat st;
+  if (strcmp(path, "-") && stat(path, &st))
+    return "access";
+  if (strcmp(path, "-") && S_ISDIR(st.st_mode))
+  {
+    DIR *dir = opendir(path);
+    if (!dir)
+      return "open directory";
+    size_t first = b.files.size();
+    while (struct dirent *entry = readdir(dir))
+    {
+      size_t len = strlen(entry->d_name);
+      if (len < 4 || strcmp(entry->d_name + len - 4, ".cnf"))
+        continue;
+      std::string name = std::string(path) + "/" + entry->d_name;
+      if (!stat(name.c_str(), &st) && S_ISREG(st.st_mode))
+        b.files.push_back(name);
+    }
+    closedir(dir);
+    std::sort(b.files.begin() + first, b.files.end());
+    return 0;
+  }
+  FILE *list = strcmp(path, "-") ? fopen(path, "r") : stdin;
+  if (!list)
+    return "open and read";
+  char *line = 0;
+  size_t size = 0;
+  ssize_t len;
+  while ((len = getline(&line, &size, list)) >= 0)
+  {
+    while (len && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+      line[--len] = 0;
+    if (len)
+      b.files.push_back(line);
+  }
+  free(line);
+  if (list != stdin)
+    fclose(list);
+  return 0;
+}
+
+// Run 'process' on all files with at most 'threads' workers, which call
+// 'finish' before they exit to free their thread local memory.  Remaining
+// instances are skipped as soon as 'interrupted' (if given) is set.
+// Returns the number of workers.
+
+static inline size_t run_batch_workers(Batch &b, int threads,
+                                       bool (*process)(const char *path),
+                                       void (*finish)(void),
+                                       const volatile sig_atomic_t *interrupted)
+{
+  size_t workers = std::min((size_t)threads, b.files.size());
+  auto worker = [&]()
+  {
+    stdout_writer.lock = &b.output_lock;
+    for (size_t i; !(interrupted && *interrupted) &&
+                   (i = b.next++) < b.files.size();)
+      if (!process(b.files[i].c_str()))
+        b.failed++;
+    finish();
+  };
+  std::vector<std::thread> pool;
+  for (size_t i = 0; i < workers; i++)
+    pool.emplace_back(worker);
+  for (auto &thread : pool)
+    thread.join();
+  return workers;
+}
+
+#endif
@@ -0,0 +1,213 @@
+// Result cache shared by 'one_symmetry' and 'two_symmetry'.
+//
+// Results are cached in files named by a 128 bit hash of the input bytes
+// and of every option changing the output.  The hash uses the block and
+// finalization functions of MurmurHash3 (x64, 128 bit) with both halves
+// seeded by the options.  A result is written to a temporary file which
+// is renamed afterwards, thus concurrent runs never see partial results.
+//
+// The first line of an entry holds the numbers of the 'Run_info' of the
+// run which stored it, thus statistics of a cache hit report the same
+// formula size and search counts (see 'stats.hpp').  The output follows.
+
+#ifndef _cache_hpp_INCLUDED
+#define _cache_hpp_INCLUDED
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "output.hpp"
+#include "stats.hpp"
+
+struct Hash128
+{
+  uint64_t h1, h2;
+  size_t length;
+};
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t fmix64(uint64_t k)
+{
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdull;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ull;
+  k ^= k >> 33;
+  return k;
+}
+
+static const uint64_t murmur_c1 = 0x87c37b91114253d5ull;
+static const uint64_t murmur_c2 = 0x4cf5ad432745937full;
+
+static inline void hash_blocks(Hash128 &h, const unsigned char *data,
+                               size_t bytes)
+{
+  assert(!(bytes % 16));
+  for (size_t i = 0; i < bytes; i += 16)
+  {
+    uint64_t k1, k2;
+    memcpy(&k1, data + i, 8);
+    memcpy(&k2, data + i + 8, 8);
+    k1 *= murmur_c1, k1 = rotl64(k1, 31), k1 *= murmur_c2, h.h1 ^= k1;
+    h.h1 = rotl64(h.h1, 27) + h.h2, h.h1 = h.h1 * 5 + 0x52dce729;
+    k2 *= murmur_c2, k2 = rotl64(k2, 33), k2 *= murmur_c1, h.h2 ^= k2;
+    h.h2 = rotl64(h.h2, 31) + h.h1, h.h2 = h.h2 * 5 + 0x38495ab5;
+  }
+  h.length += bytes;
+}
+
+static inline void hash_tail(Hash128 &h, const unsigned char *data,
+                             size_t bytes)
+{
+  assert(bytes < 16);
+  uint64_t k1 = 0, k2 = 0;
+  for (size_t i = bytes; i-- > 8;)
+    k2 = k2 << 8 | data[i];
+  for (size_t i = std::min(bytes, (size_t)8); i-- > 0;)
+    k1 = k1 << 8 | data[i];
+  if (bytes > 8)
+    k2 *= murmur_c2, k2 = rotl64(k2, 33), k2 *= murmur_c1, h.h2 ^= k2;
+  if (bytes)
+    k1 *= murmur_c1, k1 = rotl64(k1, 31), k1 *= murmur_c2, h.h1 ^= k1;
+  h.length += bytes;
+  h.h1 ^= h.length, h.h2 ^= h.length;
+  h.h1 += h.h2, h.h2 += h.h1;
+  h.h1 = fmix64(h.h1), h.h2 = fmix64(h.h2);
+  h.h1 += h.h2, h.h2 += h.h1;
+}
+
+static inline Hash128 hash_string(const std::string &str, uint64_t seed)
+{
+  Hash128 h = {seed, seed, 0};
+  size_t blocks = str.size() & ~(size_t)15;
+  hash_blocks(h, (const unsigned char *)str.data(), blocks);
+  hash_tail(h, (const unsigned char *)str.data() + blocks, str.size() - blocks);
+  return h;
+}
+
+// Hash the input without moving the read position of 'file'.  Returns an
+// empty key for input which can not be read twice (pipes and sockets).
+
+static inline std::string cache_key(FILE *file, const std::string &options)
+{
+  int fd = fileno(file);
+  struct stat st;
+  if (fstat(fd, &st) || !S_ISREG(st.st_mode))
+    return "";
+  Hash128 seed = hash_string(options, 0);
+  Hash128 h = {seed.h1, seed.h2, 0};
+  std::vector<unsigned char> buffer(1 << 20);
+  off_t offset = 0;
+  for (;;)
+  {
+    size_t size = 0;
+    while (size < buffer.size())
+    {
+      ssize_t bytes = pread(fd, buffer.data() + size, buffer.size() - size,
+                            offset + size);
+      if (bytes < 0 && errno == EINTR)
+        continue;
+      if (bytes < 0)
+        return "";
+      if (!bytes)
+        break;
+      size += bytes;
+    }
+    offset += size;
+    size_t blocks = size & ~(size_t)15;
+    hash_blocks(h, buffer.data(), blocks);
+    if (size < buffer.size())
+    {
+      hash_tail(h, buffer.data() + blocks, size - blocks);
+      break;
+    }
+  }
+  char key[33];
+  snprintf(key, sizeof key, "%016llx%016llx", (unsigned long long)h.h1,
+           (unsigned long long)h.h2);
+  return key;
+}
+
+// Open the entry of 'key' and read the stored numbers into 'run', which
+// is marked as cache hit.  Entries without valid first line are misses.
+// Returns the entry positioned at the cached output or zero on a miss.
+
+static inline FILE *lookup_cache(const char *dir, const std::string &key,
+                                 Run_info &run)
+{
+  std::string path = std::string(dir) + "/" + key;
+  FILE *entry = fopen(path.c_str(), "r");
+  if (!entry)
+    return 0;
+  Run_info cached = run;
+  if (fscanf(entry, "%d %zu %zu %zu", &cached.variables, &cached.clauses,
+             &cached.checked, &cached.found) != 4 ||
+      getc(entry) != '\n')
+  {
+    fclose(entry);
+    return 0;
+  }
+  run = cached;
+  run.cache_hit = true;
+  return entry;
+}
+
+// Copy the cached output to 'out' and close the entry.
+
+static inline void copy_cache(FILE *entry, Writer &out)
+{
+  char buffer[1 << 16];
+  size_t bytes;
+  while ((bytes = fread(buffer, 1, sizeof buffer, entry)))
+    write_bytes(out, buffer, bytes);
+  fclose(entry);
+}
+
+static inline bool write_all(int fd, const char *p, size_t left)
+{
+  while (left)
+  {
+    ssize_t bytes = write(fd, p, left);
+    if (bytes < 0 && errno == EINTR)
+      continue;
+    if (bytes <= 0)
+      return false;
+    p += bytes;
+    left -= bytes;
+  }
+  return true;
+}
+
+static inline void store_cache(const char *dir, const std::string &key,
+                               const Run_info &run, const std::string &result)
+{
+  std::string path = std::string(dir) + "/" + key;
+  std::string tmp = std::string(dir) + "/." + key + ".XXXXXX";
+  int fd = mkstemp(&tmp[0]);
+  if (fd < 0)
+    return;
+  char header[128];
+  int size = snprintf(header, sizeof header, "%d %zu %zu %zu\n",
+                      run.variables, run.clauses, run.checked, run.found);
+  bool ok = write_all(fd, header, size) &&
+            write_all(fd, result.data(), result.size());
+  fchmod(fd, 0644);
+  if (close(fd) || !ok || rename(tmp.c_str(), path.c_str()))
+    unlink(tmp.c_str());
+}
+
+#endif
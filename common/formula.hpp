@@ -0,0 +1,264 @@
+// Clauses and occurrence lists shared by all detection engines.
+//
+// A 'Formula' is the context the engines of 'negation.hpp' and
+// 'transposition.hpp' work on.  Clauses are allocated from an arena of
+// large blocks and every literal has an occurrence list in 'matrix'.
+// Resetting a formula keeps all its memory, thus a thread (or a library
+// context) processing one formula after the other only allocates when a
+// formula is larger than all before.
+
+#ifndef _formula_hpp_INCLUDED
+#define _formula_hpp_INCLUDED
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "memory.hpp"
+#include "stats.hpp"
+
+struct Clause
+{
+  size_t id;    // Position in 'clauses'.
+  unsigned size;
+  bool garbage; // removed by eliminating a symmetric variable
+  int literals[];
+
+  // The following two functions allow simple ranged-based for-loop
+  // iteration over Clause literals with the following idiom:
+  //
+  //   Clause *c = ...
+  //   for (auto lit : *c)
+  //     do_something_with (lit);
+  //
+  int *begin() { return literals; }
+  int *end() { return literals + size; }
+};
+
+struct Formula
+{
+  int variables; // Variable range: 1,..,<variables>
+  size_t added;  // Number of added clauses.
+  std::vector<Clause *> clauses;
+  Clause *empty_clause; // Empty clause found.
+
+  // Occurrence lists indexed by literals, sized for 'allocated' variables.
+
+  std::vector<Clause *> *matrix;
+  int allocated;
+
+  // Clause arena, rewound instead of freed by 'reset_formula'.
+
+  std::vector<std::pair<char *, size_t>> arena;
+  size_t arena_block, arena_used;
+};
+
+static inline void delete_matrix(Formula &f)
+{
+  if (!f.matrix)
+    return;
+  f.matrix -= f.allocated;
+  delete[] f.matrix;
+  f.matrix = 0;
+}
+
+// Start a formula over the variables '1..variables'.
+
+static inline void initialize_formula(Formula &f, int variables)
+{
+  assert(variables < INT_MAX);
+  f.variables = variables;
+  if (f.matrix && variables <= f.allocated)
+    return;
+  delete_matrix(f);
+  f.allocated = variables;
+  unsigned size = variables + 1;
+
+  unsigned twice = 2 * size;
+
+  f.matrix = new std::vector<Clause *>[twice];
+
+  // We subtract 'variables' in order to be able to access
+  // the arrays with a negative index (valid in C/C++).
+
+  f.matrix += variables;
+}
+
+static inline Clause *allocate_clause(Formula &f, size_t bytes)
+{
+  bytes = (bytes + alignof(Clause) - 1) & ~(alignof(Clause) - 1);
+  while (f.arena_block < f.arena.size())
+  {
+    auto &block = f.arena[f.arena_block];
+    if (f.arena_used + bytes <= block.second)
+    {
+      char *res = block.first + f.arena_used;
+      f.arena_used += bytes;
+      return (Clause *)res;
+    }
+    f.arena_block++;
+    f.arena_used = 0;
+  }
+  size_t size = std::max(bytes, (size_t)1 << 20);
+  f.arena.push_back({new char[size], size});
+  f.arena_used = bytes;
+  return (Clause *)f.arena.back().first;
+}
+
+static inline Clause *add_clause(Formula &f, const int *literals,
+                                 size_t size)
+{
+  size_t bytes = sizeof(struct Clause) + size * sizeof(int);
+  Clause *c = allocate_clause(f, bytes);
+
+  c->id = f.added++;
+
+  assert(f.clauses.size() <= (size_t)INT_MAX);
+  c->size = size;
+  c->garbage = false;
+
+  int *q = c->literals;
+  for (size_t i = 0; i < size; i++)
+    *q++ = literals[i];
+
+  f.clauses.push_back(c);
+
+  if (!size)
+    f.empty_clause = c;
+  return c;
+}
+
+// Connect the literals of all clauses in the matrix.
+
+static inline void build_index(Formula &f)
+{
+  Phase_scope scope(INDEX);
+  for (auto c : f.clauses)
+    for (auto lit : *c)
+      f.matrix[lit].push_back(c);
+}
+
+// Clear the formula but keep its memory.
+
+static inline void reset_formula(Formula &f)
+{
+  int used = std::min(f.variables, f.allocated);
+  for (int lit = -used; f.matrix && lit <= used; lit++)
+    f.matrix[lit].clear();
+  f.clauses.clear();
+  f.arena_block = f.arena_used = 0;
+  f.empty_clause = 0;
+  f.added = 0;
+  f.variables = 0;
+}
+
+static inline void release_formula(Formula &f)
+{
+  for (auto &block : f.arena)
+    delete[] block.first;
+  f.arena.clear();
+  f.arena_block = f.arena_used = 0;
+  delete_matrix(f);
+}
+
+// Note the memory of clauses and occurrence lists (see 'memory.hpp').
+
+static inline void account_memory(const Formula &f)
+{
+  Memory_sum clause_memory;
+  clause_memory.add(f.clauses);
+  for (size_t b = 0; b < f.arena.size(); b++)
+    clause_memory.add(b < f.arena_block    ? f.arena[b].second
+                      : b == f.arena_block ? f.arena_used
+                                           : 0,
+                      f.arena[b].second);
+  note_memory(CLAUSE_MEMORY, clause_memory);
+
+  Memory_sum index_memory;
+  if (f.matrix)
+  {
+    size_t header = sizeof(std::vector<Clause *>);
+    index_memory.add(2 * ((size_t)f.variables + 1) * header,
+                     2 * ((size_t)f.allocated + 1) * header);
+    for (int lit = -f.allocated; lit <= f.allocated; lit++)
+      index_memory.add(f.matrix[lit]);
+  }
+  note_memory(INDEX_MEMORY, index_memory);
+}
+
+static inline uint64_t mix_hash(uint64_t x)
+{
+  x += 0x9e3779b97f4a7c15ull;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+// Fingerprint invariant under reordering clauses and literals and under
+// renaming literals (variables and their signs), computed by a fixed
+// number of color refinement rounds on the literal-clause graph of the
+// automorphism search.  Instead of sorting cells the colors of neighbors
+// are combined by sums of hashes, thus every round takes linear time.
+// Formulas which color refinement can not tell apart get the same
+// fingerprint, which is rare for practical instances.
+
+static const int fingerprint_rounds = 4;
+
+static inline std::string fingerprint(const Formula &f)
+{
+  const int variables = f.variables;
+  const auto &clauses = f.clauses;
+  std::vector<uint64_t> colors(2 * (size_t)variables + 1);
+  std::vector<uint64_t> next_colors(colors.size());
+  uint64_t *color = colors.data() + variables;
+  uint64_t *next = next_colors.data() + variables;
+  std::vector<uint64_t> clause_color(clauses.size());
+  for (size_t i = 0; i < clauses.size(); i++)
+    clause_color[i] = mix_hash(clauses[i]->size);
+
+  for (int round = 0; round < fingerprint_rounds; round++)
+  {
+    for (int lit = -variables; lit <= variables; lit++)
+    {
+      uint64_t sum = 0;
+      for (auto c : f.matrix[lit])
+        sum += mix_hash(clause_color[c->id]);
+      next[lit] = mix_hash(mix_hash(mix_hash(color[lit]) ^ sum) ^ color[-lit]);
+    }
+    std::swap(color, next);
+    for (size_t i = 0; i < clauses.size(); i++)
+    {
+      uint64_t sum = 0;
+      for (auto lit : *clauses[i])
+        sum += mix_hash(color[lit]);
+      clause_color[i] = mix_hash(mix_hash(clause_color[i]) ^ sum);
+    }
+  }
+
+  // Two independent sums of all final colors give 128 bits.
+
+  uint64_t h1 = mix_hash(variables), h2 = mix_hash(clauses.size());
+  for (int lit = -variables; lit <= variables; lit++)
+  {
+    if (!lit)
+      continue;
+    h1 += mix_hash(color[lit]);
+    h2 += mix_hash(color[lit] ^ 0x5bd1e9955bd1e995ull);
+  }
+  for (auto c : clause_color)
+  {
+    h1 += mix_hash(~c);
+    h2 += mix_hash(~c ^ 0x5bd1e9955bd1e995ull);
+  }
+  char buffer[33];
+  snprintf(buffer, sizeof buffer, "%016llx%016llx",
+           (unsigned long long)mix_hash(h1 ^ h2),
+           (unsigned long long)mix_hash(h2));
+  return buffer;
+}
+
+#endif
@@ -0,0 +1,162 @@
+// Clause comparison kernels of 'one_symmetry' and 'two_symmetry'.
+//
+// The kernels are templates over the clause type of the tools (which only
+// need 'size' and 'literals') so that the micro benchmark 'bench/kernels'
+// runs exactly the code of the tools.  They maintain the counters of
+// 'stats.hpp'.  Kernels which do not assume sorted literals move matched
+// literals of the second clause to the front and thus reorder it.
+
+#ifndef _kernels_hpp_INCLUDED
+#define _kernels_hpp_INCLUDED
+
+#include <cstdlib>
+
+#include "stats.hpp"
+
+// Literals of both clauses sorted by variable: compare them position by
+// position, where 'var' in the first clause matches '-var' in the second.
+
+template <class Clause>
+static bool sorted_negation_kernel(Clause *c1, Clause *c2, int var)
+{
+  stats.clause_comparisons++;
+  if (c1->size != c2->size)
+  {
+    stats.early_rejects++;
+    return false;
+  }
+
+  auto c1_literals = c1->literals;
+  auto c2_literals = c2->literals;
+
+  for (unsigned i = 0; i < c1->size; i++)
+  {
+    stats.literal_comparisons++;
+    if (abs(c1_literals[i]) == abs(var))
+    {
+      // The literals of 'var' are sorted by sign, thus the negated block
+      // in the second clause is the reversed negated block of the first.
+      unsigned end = i;
+      while (end < c1->size && abs(c1_literals[end]) == abs(var))
+        end++;
+      for (unsigned k = i; k < end; k++)
+        if (c2_literals[k] != -c1_literals[end - 1 - (k - i)])
+          return false;
+      i = end - 1;
+    }
+    else if (c1_literals[i] != c2_literals[i])
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// check whether two clauses are identical, except for a given variable
+// which occures positivly in one clause and negativly in the other
+
+template <class Clause>
+static bool negation_kernel(Clause *c1, Clause *c2, int var)
+{
+  stats.clause_comparisons++;
+  if (c1->size != c2->size)
+  {
+    stats.early_rejects++;
+    return false;
+  }
+
+  auto c1_literals = c1->literals;
+  auto c2_literals = c2->literals;
+
+  // a tautology is compared with itself, which is not reordered but
+  // only needs as many literals 'var' as '-var'
+  if (c1 == c2)
+  {
+    int balance = 0;
+    for (unsigned i = 0; i < c1->size; i++)
+    {
+      stats.literal_comparisons++;
+      balance += (c1_literals[i] == var) - (c1_literals[i] == -var);
+    }
+    return !balance;
+  }
+
+  // go throug all literals of the first clause and check
+  // if they can be matched to a literal in the second clause
+  // or to its negation if the literal is of the given variable
+  // (both phases are negated, which matters for duplicated literals
+  // in tautologies)
+  for (unsigned i = 0; i < c1->size; i++)
+  {
+    bool found = false;
+    int image = abs(c1_literals[i]) == abs(var) ? -c1_literals[i]
+                                                : c1_literals[i];
+    for (unsigned j = i; j < c2->size; j++)
+    {
+      stats.literal_comparisons++;
+      if (c2_literals[j] == image)
+      {
+        // after finding a matching literal, move it back
+        // so only unmatched literals have to be considered
+        found = true;
+        stats.swaps += i != j;
+        int tmp = c2_literals[i];
+        c2_literals[i] = c2_literals[j];
+        c2_literals[j] = tmp;
+        break;
+      }
+    }
+    if (!found)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Check whether the second clause is the image of the first under the
+// transposition of 'var1' and 'var2', i.e., identical except for 'var1'
+// replaced by 'var2' and '-var2' replaced by '-var1'.
+
+template <class Clause>
+static bool transposition_kernel(Clause *c1, Clause *c2, int var1, int var2)
+{
+  stats.clause_comparisons++;
+  if (c1->size != c2->size)
+  {
+    stats.early_rejects++;
+    return false;
+  }
+
+  auto c1_literals = c1->literals;
+  auto c2_literals = c2->literals;
+
+  for (unsigned i = 0; i < c1->size; i++)
+  {
+    bool found = false;
+    for (unsigned j = i; j < c2->size; j++)
+    {
+      stats.literal_comparisons++;
+      if (c1_literals[i] == c2_literals[j] ||
+          (c1_literals[i] == var1 && c2_literals[j] == var2) ||
+          (c1_literals[i] == -var2 && c2_literals[j] == -var1))
+      {
+        // after finding a matching literal, move it back
+        // so only unmatched literals have to be considered
+        found = true;
+        stats.swaps += i != j;
+        int tmp = c2_literals[i];
+        c2_literals[i] = c2_literals[j];
+        c2_literals[j] = tmp;
+        break;
+      }
+    }
+    if (!found)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+#endif
@@ -0,0 +1,69 @@
+// Memory accounting shared by 'one_symmetry' and 'two_symmetry'.
+//
+// The tools walk their data structures at the end of the phases which
+// build them and note the bytes in use and reserved (including vector
+// slack) per subsystem below, keeping the maximum of every subsystem.
+// This is reported with '--stats' next to the peak resident set size.
+// With '--memory-limit=<MB>' the memory of an instance is projected from
+// its header before anything is allocated (and again while parsing with
+// the number of literals read) and the instance is aborted if the
+// projection exceeds the limit.
+
+#ifndef _memory_hpp_INCLUDED
+#define _memory_hpp_INCLUDED
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+enum Memory_kind
+{
+  CLAUSE_MEMORY,    // Clauses and the clause stack.
+  INDEX_MEMORY,     // Occurrence lists and their headers.
+  CANDIDATE_MEMORY, // Candidate and symmetry lists.
+  SCRATCH_MEMORY,   // Temporary arrays of filters and searches.
+  MEMORY_KINDS
+};
+
+static const char *memory_names[MEMORY_KINDS] = {"clauses", "index",
+                                                 "candidates", "scratch"};
+
+struct Memory_usage
+{
+  size_t bytes[MEMORY_KINDS];    // Actually used.
+  size_t reserved[MEMORY_KINDS]; // Allocated including slack.
+};
+
+static thread_local Memory_usage memory;
+
+static int memory_limit; // In megabytes, zero means unlimited.
+
+// Adds up the memory of one subsystem.
+
+struct Memory_sum
+{
+  size_t bytes = 0, reserved = 0;
+  template <class T> void add(const std::vector<T> &v)
+  {
+    bytes += v.size() * sizeof(T);
+    reserved += v.capacity() * sizeof(T);
+  }
+  void add(size_t used, size_t allocated)
+  {
+    bytes += used;
+    reserved += allocated;
+  }
+};
+
+static inline void note_memory(Memory_kind kind, const Memory_sum &sum)
+{
+  memory.bytes[kind] = std::max(memory.bytes[kind], sum.bytes);
+  memory.reserved[kind] = std::max(memory.reserved[kind], sum.reserved);
+}
+
+static inline bool exceeds_memory_limit(double bytes)
+{
+  return memory_limit && bytes > memory_limit * 1048576.0;
+}
+
+#endif
@@ -0,0 +1,351 @@
+// Negation symmetries of single variables, the engine of 'one_symmetry'.
+//
+// A variable 'v' is negation symmetric if replacing 'v' by '-v' maps the
+// formula onto itself, i.e., every clause 'C v' has a partner 'C -v' and
+// vice versa.  All state of a search is kept in a 'Negation_search' on a
+// 'Formula' (see 'formula.hpp'), which the tool and 'lib/symmetry.cpp'
+// keep as their context.  The kernels, sorting and eliminations reorder
+// and shrink the clauses of the formula.
+
+#ifndef _negation_hpp_INCLUDED
+#define _negation_hpp_INCLUDED
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+#include "formula.hpp"
+#include "kernels.hpp"
+#include "memory.hpp"
+#include "profile.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+
+struct Negation_options
+{
+  bool sort_clauses;    // sort clauses of canditates in matrix by size
+  bool sort_literals;   // sort literals in clauses of candidates
+  bool clause_swapping; // use clause swapping in check_symmetries
+  bool fixpoint;        // eliminate symmetric variables until none is left
+
+  // Called for every symmetric variable as soon as it is found, e.g., for
+  // printing it immediately in streaming mode.
+
+  void (*found)(int var);
+};
+
+struct Negation_search
+{
+  Formula *formula;
+  const Negation_options *options;
+  std::vector<int> candidates;
+  std::vector<int> symmetries;
+  size_t checked; // Candidates checked.
+
+  // Worklist of '--fixpoint'.
+
+  std::vector<int> worklist;
+  std::vector<char> scheduled;
+};
+
+static inline void sort_clauses_of(Negation_search &s, int can)
+{
+  auto matrix = s.formula->matrix;
+  std::sort(matrix[can].begin(), matrix[can].end(), [](Clause *i, Clause *j)
+            { return i->size < j->size; });
+  std::sort(matrix[-can].begin(), matrix[-can].end(), [](Clause *i, Clause *j)
+            { return i->size < j->size; });
+}
+
+// literals of the same variable (in tautologies) are ordered by sign too,
+// otherwise identical clauses could end up in different orders
+static inline void sort_literals_of(Negation_search &s, int can)
+{
+  auto matrix = s.formula->matrix;
+  auto less = [](int i, int j)
+  { return abs(i) < abs(j) || (abs(i) == abs(j) && i < j); };
+  for (auto c : matrix[can])
+  {
+    std::sort(c->begin(), c->end(), less);
+  }
+  for (auto c : matrix[-can])
+  {
+    std::sort(c->begin(), c->end(), less);
+  }
+}
+
+// find candidate variables by checking whether their positive and negative occurences are the same
+static inline void find_candidates(Negation_search &s)
+{
+  Phase_scope scope(FILTER);
+  auto matrix = s.formula->matrix;
+  for (int i = 1; i <= s.formula->variables; i++)
+  {
+    if (matrix[i].size() != 0 && matrix[i].size() == matrix[-i].size())
+    {
+      s.candidates.push_back(i);
+    }
+  }
+  for (auto can : s.candidates)
+  {
+    if (s.options->sort_clauses)
+      sort_clauses_of(s, can);
+    if (s.options->sort_literals)
+      sort_literals_of(s, can);
+  }
+}
+
+// check whether two clauses are identical, except for a given variable
+// which occures positivly in one clause and negativly in the other
+static inline bool check_clause_symmetry(Negation_search &s, Clause *c1,
+                                         Clause *c2, int var)
+{
+  if (s.options->sort_literals)
+  {
+    return sorted_negation_kernel(c1, c2, var);
+  }
+  return negation_kernel(c1, c2, var);
+}
+
+// check for a syntactic symmetry of a given variable with its negation
+static inline bool check_symmetry(Negation_search &s, int var)
+{
+  auto &pos_occs = s.formula->matrix[var];
+  auto &neg_occs = s.formula->matrix[-var];
+  // go through all clauses with a positive occurence of the given variable
+  // and check if there exists an otherwise identical clause with a negative occurence
+  for (auto c1 : pos_occs)
+  {
+    bool found = false;
+    for (auto c2 : neg_occs)
+    {
+      if (check_clause_symmetry(s, c1, c2, var))
+      {
+        found = true;
+        break;
+      }
+    }
+    if (!found)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+static inline bool check_symmetry_swap(Negation_search &s, int var)
+{
+  auto &pos_occs = s.formula->matrix[var];
+  auto &neg_occs = s.formula->matrix[-var];
+  bool reused = false;
+  // go through all clauses with a positive occurence of the given variable
+  // and check if there exists an otherwise identical clause with a negative occurence
+  for (size_t i = 0; i < pos_occs.size(); i++)
+  {
+    bool found = false;
+    for (size_t j = i; j < neg_occs.size(); j++)
+    {
+      if (check_clause_symmetry(s, pos_occs[i], neg_occs[j], var))
+      {
+        found = true;
+        stats.swaps += i != j;
+        // after finding a matching clause, move it back
+        // so only unmatched clauses have to be considered
+        Clause *tmp = neg_occs[i];
+        neg_occs[i] = neg_occs[j];
+        neg_occs[j] = tmp;
+        break;
+      }
+    }
+    // with duplicated clauses the partner might already be matched
+    for (size_t j = 0; !found && j < i; j++)
+    {
+      if (check_clause_symmetry(s, pos_occs[i], neg_occs[j], var))
+      {
+        found = reused = true;
+      }
+    }
+    if (!found)
+    {
+      return false;
+    }
+  }
+  // without a one-to-one matching the other direction needs a check too
+  return !reused || check_symmetry(s, -var);
+}
+
+static inline bool is_symmetric(Negation_search &s, int var)
+{
+  auto matrix = s.formula->matrix;
+  s.checked++;
+  double start = trace_path || profile_top ? trace_clock() : 0;
+  uint64_t comparisons = stats.clause_comparisons;
+  bool res;
+  if (s.options->clause_swapping)
+  {
+    res = check_symmetry_swap(s, var);
+  }
+  else
+  {
+    res = check_symmetry(s, var) && check_symmetry(s, -var);
+  }
+  if (trace_path)
+    trace_check(start, "check", "check %d", var);
+  if (profile_top)
+    profile_check(var, matrix[var].size() + matrix[-var].size(), 0, 0,
+                  stats.clause_comparisons - comparisons, start);
+  return res;
+}
+
+static inline void found_symmetry(Negation_search &s, int var)
+{
+  s.symmetries.push_back(var);
+  if (s.options->found)
+    s.options->found(var);
+}
+
+static inline void find_symmetries(Negation_search &s)
+{
+  Phase_scope scope(CHECK);
+  for (auto var : s.candidates)
+  {
+    if (is_symmetric(s, var))
+    {
+      found_symmetry(s, var);
+    }
+  }
+}
+
+static inline void schedule(Negation_search &s, int var)
+{
+  if (s.options->fixpoint && !s.scheduled[var])
+  {
+    s.scheduled[var] = true;
+    s.worklist.push_back(var);
+  }
+}
+
+static inline void disconnect_literal(Negation_search &s, int lit, Clause *c)
+{
+  auto &occs = s.formula->matrix[lit];
+  auto it = std::find(occs.begin(), occs.end(), c);
+  assert(it != occs.end());
+  *it = occs.back();
+  occs.pop_back();
+}
+
+// If 'var' is symmetric every clause 'C v' has a partner 'C -v' and vice
+// versa, so both can be replaced by 'C'.  This is done by removing the
+// clauses with '-var' and the literal 'var' from the others.  The formula
+// restricted to either value of 'var' stays the same, which thus doubles
+// the number of models.  Symmetries of other variables are preserved.
+// Only the occurrence lists of removed clauses are updated and in fixpoint
+// mode all variables sharing a clause with 'var' are scheduled again.
+
+static inline void eliminate_variable(Negation_search &s, int var)
+{
+  auto matrix = s.formula->matrix;
+  for (auto c : matrix[-var])
+  {
+    if (c->garbage) // Occurs twice with duplicated literal '-var'.
+      continue;
+    c->garbage = true;
+    for (auto lit : *c)
+    {
+      if (lit != -var)
+        disconnect_literal(s, lit, c);
+      schedule(s, abs(lit));
+    }
+  }
+  for (auto c : matrix[var])
+  {
+    int *q = c->literals;
+    for (auto lit : *c)
+    {
+      if (lit != var)
+        *q++ = lit;
+      schedule(s, abs(lit));
+    }
+    c->size = q - c->literals;
+  }
+  matrix[var].clear();
+  matrix[-var].clear();
+}
+
+// Eliminating a symmetric variable merges clause pairs, after which
+// variables sharing these clauses might become symmetric too.  Instead of
+// starting over, only variables touched by an elimination are checked
+// again until no more symmetric variables are found.
+
+static inline void find_symmetries_fixpoint(Negation_search &s)
+{
+  Phase_scope scope(CHECK);
+  auto matrix = s.formula->matrix;
+  s.scheduled.assign(s.formula->variables + 1, false);
+  for (auto var : s.candidates)
+  {
+    schedule(s, var);
+  }
+  for (size_t i = 0; i < s.worklist.size(); i++)
+  {
+    int var = s.worklist[i];
+    s.scheduled[var] = false;
+    if (matrix[var].size() == 0 || matrix[var].size() != matrix[-var].size())
+    {
+      continue;
+    }
+    if (s.options->sort_clauses)
+    {
+      sort_clauses_of(s, var);
+    }
+    if (s.options->sort_literals)
+    {
+      sort_literals_of(s, var);
+    }
+    if (is_symmetric(s, var))
+    {
+      found_symmetry(s, var);
+      eliminate_variable(s, var);
+    }
+  }
+  s.worklist.clear();
+}
+
+// Candidates and symmetric variables of the formula, after which all
+// symmetric variables are eliminated in fixpoint mode.
+
+static inline void find_negation_symmetries(Negation_search &s)
+{
+  find_candidates(s);
+  if (s.options->fixpoint)
+    find_symmetries_fixpoint(s);
+  else
+    find_symmetries(s);
+}
+
+// Note the memory of candidates and worklist (see 'memory.hpp').
+
+static inline void account_memory(const Negation_search &s)
+{
+  Memory_sum candidate_memory;
+  candidate_memory.add(s.candidates);
+  candidate_memory.add(s.symmetries);
+  note_memory(CANDIDATE_MEMORY, candidate_memory);
+
+  Memory_sum scratch;
+  scratch.add(s.worklist);
+  scratch.add(s.scheduled);
+  note_memory(SCRATCH_MEMORY, scratch);
+}
+
+// Clear the search but keep its memory.
+
+static inline void reset_search(Negation_search &s)
+{
+  s.candidates.clear();
+  s.symmetries.clear();
+  s.worklist.clear();
+  s.checked = 0;
+}
+
+#endif
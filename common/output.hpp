@@ -0,0 +1,225 @@
+// Buffered output shared by 'one_symmetry' and 'two_symmetry'.
+//
+// Symmetries and breaking clauses are written literal by literal, which
+// through 'printf' and a flush per line makes large outputs syscall bound.
+// A 'Writer' collects output in a large user-space buffer, formats
+// integers by hand and only writes the buffer when it is full or at
+// explicit flush points (after parsing, before errors and at the end).
+// The buffer is allocated on the heap with the first output, thus writers
+// are small, in particular the thread local ones of threads never writing.
+//
+// Each thread has its own 'stdout_writer'.  If threads share an output
+// 'lock', flushes only hold the output back (the buffer grows instead) and
+// 'release_writer' writes all of it at once while holding the lock, thus
+// output stays in one piece without serializing the threads producing it.
+
+#ifndef _output_hpp_INCLUDED
+#define _output_hpp_INCLUDED
+
+#include <cerrno>
+#include <climits>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+
+#include <unistd.h>
+
+struct Writer
+{
+  int fd;
+  size_t size;
+  size_t held;     // Flushed but held back until 'release_writer'.
+  size_t capacity; // Zero until the buffer is allocated.
+  std::mutex *lock;
+  bool keep_going;   // Drop output on write errors (closed sockets).
+  std::string *copy; // Also collect everything written here.
+  char *buffer;
+};
+
+static const size_t writer_capacity = 1 << 20;
+
+static thread_local Writer stdout_writer = {1, 0, 0, 0, 0, false, 0, 0};
+
+static inline void write_out(Writer &w, const char *p, size_t left)
+{
+  while (left)
+  {
+    ssize_t bytes = write(w.fd, p, left);
+    if (bytes < 0 && errno == EINTR)
+      continue;
+    if (bytes <= 0 && w.keep_going)
+      break;
+    if (bytes <= 0)
+    {
+      fprintf(stderr, "babysat: error: write failed: %s\n", strerror(errno));
+      exit(1);
+    }
+    p += bytes;
+    left -= bytes;
+  }
+}
+
+static inline void flush_writer(Writer &w)
+{
+  if (w.copy)
+    w.copy->append(w.buffer + w.held, w.size - w.held);
+  if (w.lock)
+    w.held = w.size;
+  else
+  {
+    write_out(w, w.buffer, w.size);
+    w.size = 0;
+  }
+}
+
+// Slow path of all writes, which also allocates the buffer on first use.
+// Makes room for 'n' bytes, if output is held back by growing the buffer.
+
+static inline void make_room(Writer &w, size_t n)
+{
+  if (!w.lock)
+    flush_writer(w);
+  size_t capacity = w.capacity ? w.capacity : writer_capacity;
+  while (w.lock && capacity - w.size < n)
+    capacity *= 2;
+  if (capacity == w.capacity)
+    return;
+  char *buffer = new char[capacity];
+  if (w.size)
+    memcpy(buffer, w.buffer, w.size);
+  delete[] w.buffer;
+  w.buffer = buffer;
+  w.capacity = capacity;
+}
+
+// Write everything held back while holding the lock.  A buffer grown by a
+// large output is freed, thus it is not kept for all remaining instances.
+
+static inline void release_writer(Writer &w)
+{
+  flush_writer(w);
+  if (!w.lock)
+    return;
+  {
+    std::lock_guard<std::mutex> guard(*w.lock);
+    write_out(w, w.buffer, w.size);
+  }
+  w.size = w.held = 0;
+  if (w.capacity > writer_capacity)
+  {
+    delete[] w.buffer;
+    w.buffer = 0;
+    w.capacity = 0;
+  }
+}
+
+// Flush and free the buffer (at the end of the thread of the writer).
+
+static inline void delete_writer(Writer &w)
+{
+  release_writer(w);
+  delete[] w.buffer;
+  w.buffer = 0;
+  w.capacity = 0;
+}
+
+static inline void write_bytes(Writer &w, const char *bytes, size_t n)
+{
+  if (w.size + n > w.capacity)
+  {
+    make_room(w, n);
+    if (n > w.capacity - w.size)
+    {
+      for (size_t i = 0; i < n; i += w.capacity)
+      {
+        size_t chunk = n - i < w.capacity ? n - i : w.capacity;
+        memcpy(w.buffer, bytes + i, chunk);
+        w.size = chunk;
+        flush_writer(w);
+      }
+      return;
+    }
+  }
+  memcpy(w.buffer + w.size, bytes, n);
+  w.size += n;
+}
+
+static inline void write_char(Writer &w, char ch)
+{
+  if (w.size == w.capacity)
+    make_room(w, 1);
+  w.buffer[w.size++] = ch;
+}
+
+static inline void write_string(Writer &w, const char *str)
+{
+  write_bytes(w, str, strlen(str));
+}
+
+static inline void write_size(Writer &w, size_t value)
+{
+  char tmp[24], *p = tmp + sizeof tmp;
+  do
+    *--p = '0' + value % 10;
+  while (value /= 10);
+  write_bytes(w, p, tmp + sizeof tmp - p);
+}
+
+static inline void write_int(Writer &w, int value)
+{
+  if (value < 0)
+  {
+    write_char(w, '-');
+    write_size(w, -(size_t)(long)value);
+  }
+  else
+    write_size(w, value);
+}
+
+// Literal followed by a space, the way clauses and cycles are printed.
+
+static inline void write_literal(Writer &w, int lit)
+{
+  write_int(w, lit);
+  write_char(w, ' ');
+}
+
+static inline void vwrite_format(Writer &w, const char *fmt, va_list ap)
+{
+  va_list copy;
+  va_copy(copy, ap);
+  size_t room = w.capacity - w.size;
+  int len = vsnprintf(w.buffer + w.size, room, fmt, copy);
+  va_end(copy);
+  if (len < 0)
+    return;
+  if ((size_t)len < room)
+  {
+    w.size += len;
+    return;
+  }
+  make_room(w, len + 1);
+  room = w.capacity - w.size;
+  if ((size_t)len < room)
+    w.size += vsnprintf(w.buffer + w.size, room, fmt, ap);
+  else
+  {
+    char *tmp = new char[len + 1];
+    vsnprintf(tmp, len + 1, fmt, ap);
+    write_bytes(w, tmp, len);
+    delete[] tmp;
+  }
+}
+
+static inline void write_format(Writer &w, const char *fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  vwrite_format(w, fmt, ap);
+  va_end(ap);
+}
+
+#endif
@@ -0,0 +1,124 @@
+// Hardware performance counters shared by 'one_symmetry' and
+// 'two_symmetry'.
+//
+// With '--perf' every thread opens the counters below for itself through
+// Linux 'perf_event_open' (user space only) and every phase scope adds up
+// the counted events of its phase.  Counters the kernel or the machine does
+// not provide (virtual machines, containers, 'perf_event_paranoid' too
+// high) are reported as unavailable and the rest still works.  Counters
+// are scaled if the kernel had to multiplex them.
+
+#ifndef _perf_hpp_INCLUDED
+#define _perf_hpp_INCLUDED
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+enum Perf_counter
+{
+  CYCLES,
+  INSTRUCTIONS,
+  L1_MISSES,
+  LLC_MISSES,
+  BRANCH_MISSES,
+  PERF_COUNTERS
+};
+
+static const char *perf_names[PERF_COUNTERS] = {
+    "cycles", "instructions", "l1_misses", "llc_misses", "branch_misses"};
+
+static bool perf_counting;          // Counters requested.
+static std::atomic<int> perf_error; // Of failing 'perf_event_open'.
+
+static thread_local bool perf_opened;
+static thread_local int perf_fds[PERF_COUNTERS];
+
+static inline void open_perf_counters(void)
+{
+  perf_opened = true;
+  for (int k = 0; k < PERF_COUNTERS; k++)
+  {
+    perf_fds[k] = -1;
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof attr);
+    attr.size = sizeof attr;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    switch (k)
+    {
+    case CYCLES:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_CPU_CYCLES;
+      break;
+    case INSTRUCTIONS:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+      break;
+    case L1_MISSES:
+      attr.type = PERF_TYPE_HW_CACHE;
+      attr.config = PERF_COUNT_HW_CACHE_L1D |
+                    PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                    PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+      break;
+    case LLC_MISSES:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_CACHE_MISSES;
+      break;
+    default:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+      break;
+    }
+    perf_fds[k] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (perf_fds[k] < 0)
+      perf_error = errno;
+#else
+    perf_error = ENOSYS;
+#endif
+  }
+}
+
+static inline bool perf_available(int k)
+{
+  return perf_opened && perf_fds[k] >= 0;
+}
+
+// Current values of the counters of this thread (zero if unavailable).
+
+static inline void read_perf_counters(uint64_t values[PERF_COUNTERS])
+{
+  if (!perf_opened)
+    open_perf_counters();
+  for (int k = 0; k < PERF_COUNTERS; k++)
+  {
+    uint64_t data[3]; // Value, time enabled and time running.
+    values[k] = 0;
+    if (perf_fds[k] < 0 || read(perf_fds[k], data, sizeof data) != sizeof data)
+      continue;
+    if (data[2] && data[2] < data[1])
+      data[0] = (uint64_t)((double)data[0] * data[1] / data[2]);
+    values[k] = data[0];
+  }
+}
+
+static inline void close_perf_counters(void)
+{
+  for (int k = 0; perf_opened && k < PERF_COUNTERS; k++)
+    if (perf_fds[k] >= 0)
+      close(perf_fds[k]);
+  perf_opened = false;
+}
+
+#endif
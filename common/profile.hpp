@@ -0,0 +1,89 @@
+// Per check cost profile shared by 'one_symmetry' and 'two_symmetry'.
+//
+// With '--profile=<n>' every single check (a candidate variable in
+// 'one_symmetry', a variable pair in 'two_symmetry') is recorded with the
+// occurrence list sizes of its variables, its clause comparisons and its
+// time.  At the end the <n> most expensive checks and a histogram of all
+// check times are printed, showing whether a few hub variables or many
+// small ones dominate.
+
+#ifndef _profile_hpp_INCLUDED
+#define _profile_hpp_INCLUDED
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "output.hpp"
+#include "trace.hpp"
+
+static int profile_top; // Number of most expensive checks printed.
+
+struct Profile_entry
+{
+  int var1, var2;       // Second variable zero for single variables.
+  size_t occs1, occs2;  // Occurrences of both phases.
+  uint64_t comparisons; // Clause comparisons.
+  double time;          // Microseconds.
+};
+
+static thread_local std::vector<Profile_entry> profile;
+
+static inline void profile_check(int var1, size_t occs1, int var2,
+                                 size_t occs2, uint64_t comparisons,
+                                 double start)
+{
+  profile.push_back(
+      {var1, var2, occs1, occs2, comparisons, trace_clock() - start});
+}
+
+static inline void print_profile(Writer &w)
+{
+  size_t n = std::min(profile.size(), (size_t)profile_top);
+  auto expensive = [](const Profile_entry &a, const Profile_entry &b)
+  { return a.time > b.time; };
+  std::partial_sort(profile.begin(), profile.begin() + n, profile.end(),
+                    expensive);
+  write_format(w, "c\nc %zu most expensive of %zu checks\nc\n", n,
+               profile.size());
+  write_format(w, "c %12s %12s %9s %9s  %s\n", "time", "comparisons",
+               "occs1", "occs2", "variables");
+  for (size_t i = 0; i < n; i++)
+  {
+    const Profile_entry &e = profile[i];
+    write_format(w, "c %10.3fms %12llu %9zu %9zu  %d", e.time / 1e3,
+                 (unsigned long long)e.comparisons, e.occs1, e.occs2,
+                 e.var1);
+    if (e.var2)
+      write_format(w, " %d", e.var2);
+    write_char(w, '\n');
+  }
+
+  // Histogram of check times with buckets doubling from one microsecond.
+
+  std::vector<size_t> buckets;
+  std::vector<double> sums;
+  for (auto &e : profile)
+  {
+    size_t b = 0;
+    for (double limit = 1; e.time >= limit && b < 40; limit *= 2)
+      b++;
+    if (b >= buckets.size())
+      buckets.resize(b + 1), sums.resize(b + 1);
+    buckets[b]++;
+    sums[b] += e.time;
+  }
+  write_format(w, "c\nc %12s %12s %12s\n", "check time", "checks", "total");
+  for (size_t b = 0; b < buckets.size(); b++)
+  {
+    if (!buckets[b])
+      continue;
+    char label[32];
+    snprintf(label, sizeof label, "< %lluus", (unsigned long long)1 << b);
+    write_format(w, "c %12s %12zu %10.3fms\n", label, buckets[b],
+                 sums[b] / 1e3);
+  }
+  write_string(w, "c\n");
+}
+
+#endif
@@ -0,0 +1,303 @@
+// Statistics shared by 'one_symmetry' and 'two_symmetry'.
+//
+// A run is split into the phases below, each timed in thread and
+// wall-clock time by a 'Phase_scope' at its start, which also records it
+// as trace event.  Phases may be entered several times (e.g., per instance
+// in batch mode) and their times add up.
+// Counters are plain increments in the checking kernels and thus always
+// maintained.  With '--stats' the tools print a report in comment lines
+// and with '--stats-json <file>' they append a single line JSON record.
+// With '--perf' both include the hardware counters of every phase.
+// Both also include the memory noted per subsystem (see 'memory.hpp').
+
+#ifndef _stats_hpp_INCLUDED
+#define _stats_hpp_INCLUDED
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "memory.hpp"
+#include "output.hpp"
+#include "perf.hpp"
+#include "trace.hpp"
+
+enum Phase
+{
+  PARSE,  // Reading clauses.
+  INDEX,  // Building occurrence lists.
+  FILTER, // Selecting candidates (occurrence counts, sorting, LSH).
+  CHECK,  // Checking candidates and permutations.
+  OUTPUT, // Printing results.
+  PHASES
+};
+
+static const char *phase_names[PHASES] = {"parse", "index", "filter", "check",
+                                          "output"};
+
+struct Statistics
+{
+  double time[PHASES]; // Thread time.
+  double wall[PHASES]; // Wall-clock time.
+  uint64_t clause_comparisons;
+  uint64_t literal_comparisons;
+  uint64_t early_rejects; // Clauses compared only by size.
+  uint64_t swaps;         // Matched clauses and literals moved to the front.
+  uint64_t events[PHASES][PERF_COUNTERS]; // Hardware counters per phase.
+};
+
+static thread_local Statistics stats;
+
+// Get process-time of this process.  This is not portable to Windows but
+// should work on other Unixes such as MacOS as is.
+
+static inline double process_time(void)
+{
+  struct rusage u;
+  double res;
+  if (getrusage(RUSAGE_SELF, &u))
+    return 0;
+  res = u.ru_utime.tv_sec + 1e-6 * u.ru_utime.tv_usec;
+  res += u.ru_stime.tv_sec + 1e-6 * u.ru_stime.tv_usec;
+  return res;
+}
+
+// Time of the calling thread, which differs from the process time if
+// instances are processed in parallel.
+
+static inline double thread_time(void)
+{
+#ifdef RUSAGE_THREAD
+  struct rusage u;
+  if (getrusage(RUSAGE_THREAD, &u))
+    return 0;
+  return u.ru_utime.tv_sec + 1e-6 * u.ru_utime.tv_usec +
+         u.ru_stime.tv_sec + 1e-6 * u.ru_stime.tv_usec;
+#else
+  return process_time();
+#endif
+}
+
+static inline double wall_clock_time(void)
+{
+  struct timeval tv;
+  if (gettimeofday(&tv, 0))
+    return 0;
+  return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+// Maximum resident set size in kilobytes.  On Linux 'VmHWM' is used, since
+// 'ru_maxrss' also covers the memory of the parent before 'exec' (which
+// for instance adds the size of a Python interpreter running the tool).
+
+static inline size_t peak_rss(void)
+{
+  if (FILE *status = fopen("/proc/self/status", "r"))
+  {
+    char line[128];
+    size_t res = 0;
+    while (fgets(line, sizeof line, status))
+      if (sscanf(line, "VmHWM: %zu kB", &res) == 1)
+        break;
+    fclose(status);
+    if (res)
+      return res;
+  }
+  struct rusage u;
+  if (getrusage(RUSAGE_SELF, &u))
+    return 0;
+  return u.ru_maxrss;
+}
+
+struct Phase_scope
+{
+  Phase phase;
+  double time, wall, trace_start;
+  uint64_t events[PERF_COUNTERS];
+  Phase_scope(Phase p) { start(p); }
+  void start(Phase p)
+  {
+    phase = p;
+    time = thread_time();
+    wall = wall_clock_time();
+    trace_start = trace_path ? trace_clock() : 0;
+    if (perf_counting)
+      read_perf_counters(events);
+  }
+  void stop()
+  {
+    if (perf_counting)
+    {
+      uint64_t now[PERF_COUNTERS];
+      read_perf_counters(now);
+      for (int k = 0; k < PERF_COUNTERS; k++)
+        stats.events[phase][k] += now[k] - events[k];
+    }
+    stats.time[phase] += thread_time() - time;
+    stats.wall[phase] += wall_clock_time() - wall;
+    if (trace_path)
+      add_trace_event(phase_names[phase], "phase", trace_start,
+                      trace_clock() - trace_start);
+  }
+  void switch_to(Phase p)
+  {
+    stop();
+    start(p);
+  }
+  ~Phase_scope() { stop(); }
+};
+
+// Tool specific numbers reported with the statistics.
+
+struct Run_info
+{
+  const char *tool;
+  const char *file;
+  int variables;
+  size_t clauses;
+  size_t checked; // Variables or variable pairs checked.
+  size_t found;   // Symmetries found.
+  bool cache_hit; // Result and numbers above taken from the cache.
+};
+
+static inline void print_perf_counters(Writer &w)
+{
+  if (!perf_available(CYCLES) && !perf_available(INSTRUCTIONS) &&
+      !perf_available(L1_MISSES) && !perf_available(LLC_MISSES) &&
+      !perf_available(BRANCH_MISSES))
+  {
+    write_format(w, "c hardware counters unavailable: %s\nc\n",
+                 strerror(perf_error));
+    return;
+  }
+  write_format(w, "c %-6s %14s %14s %5s %12s %12s %12s\n", "phase", "cycles",
+               "instructions", "IPC", "L1 misses", "LLC misses", "br misses");
+  for (int p = 0; p < PHASES; p++)
+  {
+    write_format(w, "c %-6s", phase_names[p]);
+    const uint64_t *e = stats.events[p];
+    for (int k = 0; k < PERF_COUNTERS; k++)
+    {
+      int width = k < L1_MISSES ? 14 : 12;
+      if (k == L1_MISSES)
+      {
+        if (perf_available(CYCLES) && perf_available(INSTRUCTIONS) &&
+            e[CYCLES])
+          write_format(w, " %5.2f", (double)e[INSTRUCTIONS] / e[CYCLES]);
+        else
+          write_format(w, " %5s", "n/a");
+      }
+      if (perf_available(k))
+        write_format(w, " %*llu", width, (unsigned long long)e[k]);
+      else
+        write_format(w, " %*s", width, "n/a");
+    }
+    write_char(w, '\n');
+  }
+  write_string(w, "c\n");
+}
+
+static inline void print_statistics(Writer &w, const Run_info &run)
+{
+  write_string(w, "c\nc phase        time       wall\n");
+  double time = 0, wall = 0;
+  for (int p = 0; p < PHASES; p++)
+  {
+    write_format(w, "c %-6s %9.3fs %9.3fs\n", phase_names[p], stats.time[p],
+                 stats.wall[p]);
+    time += stats.time[p], wall += stats.wall[p];
+  }
+  write_format(w, "c %-6s %9.3fs %9.3fs\nc\n", "total", time, wall);
+  write_format(w, "c %-20s %zu\n", "checked:", run.checked);
+  if (run.cache_hit)
+    write_format(w, "c %-20s %s\n", "cache hit:", "detection skipped");
+  write_format(w, "c %-20s %llu\n", "clause comparisons:",
+               (unsigned long long)stats.clause_comparisons);
+  write_format(w, "c %-20s %llu\n", "literal comparisons:",
+               (unsigned long long)stats.literal_comparisons);
+  write_format(w, "c %-20s %llu\n", "early rejects:",
+               (unsigned long long)stats.early_rejects);
+  write_format(w, "c %-20s %llu\n", "swaps:",
+               (unsigned long long)stats.swaps);
+  write_string(w, "c\nc memory            used      reserved\n");
+  size_t bytes = 0, reserved = 0;
+  for (int k = 0; k < MEMORY_KINDS; k++)
+  {
+    write_format(w, "c %-10s %9.1f MB %9.1f MB\n", memory_names[k],
+                 memory.bytes[k] / 1048576.0, memory.reserved[k] / 1048576.0);
+    bytes += memory.bytes[k], reserved += memory.reserved[k];
+  }
+  write_format(w, "c %-10s %9.1f MB %9.1f MB\n", "total", bytes / 1048576.0,
+               reserved / 1048576.0);
+  write_format(w, "c %-10s %9.1f MB\nc\n", "peak RSS", peak_rss() / 1024.0);
+  if (perf_counting)
+    print_perf_counters(w);
+}
+
+static inline void write_json_string(Writer &w, const char *str)
+{
+  write_char(w, '"');
+  for (const char *p = str; *p; p++)
+  {
+    unsigned char ch = *p;
+    if (ch == '"' || ch == '\\')
+      write_char(w, '\\'), write_char(w, ch);
+    else if (ch < 0x20)
+      write_format(w, "\\u%04x", ch);
+    else
+      write_char(w, ch);
+  }
+  write_char(w, '"');
+}
+
+// Appends the record with a single 'write' on a file opened with
+// 'O_APPEND', thus parallel runs can share one file.  For '-' the record
+// goes to standard output in order with the rest of the output.
+
+static inline bool append_json_statistics(const char *path, const Run_info &run)
+{
+  bool to_stdout = !strcmp(path, "-");
+  Writer record = {-1, 0, 0, 0, 0, false, 0, 0};
+  Writer &w = to_stdout ? stdout_writer : record;
+  write_string(w, "{\"tool\":");
+  write_json_string(w, run.tool);
+  write_string(w, ",\"file\":");
+  write_json_string(w, run.file);
+  write_format(w, ",\"variables\":%d,\"clauses\":%zu", run.variables,
+               run.clauses);
+  for (int p = 0; p < PHASES; p++)
+    write_format(w, ",\"%s_time\":%.6f,\"%s_wall\":%.6f", phase_names[p],
+                 stats.time[p], phase_names[p], stats.wall[p]);
+  write_format(w, ",\"checked\":%zu,\"found\":%zu", run.checked, run.found);
+  write_format(w, ",\"cache_hit\":%s", run.cache_hit ? "true" : "false");
+  write_format(w, ",\"clause_comparisons\":%llu,\"literal_comparisons\":%llu",
+               (unsigned long long)stats.clause_comparisons,
+               (unsigned long long)stats.literal_comparisons);
+  write_format(w, ",\"early_rejects\":%llu,\"swaps\":%llu",
+               (unsigned long long)stats.early_rejects,
+               (unsigned long long)stats.swaps);
+  for (int k = 0; k < MEMORY_KINDS; k++)
+    write_format(w, ",\"%s_bytes\":%zu,\"%s_reserved\":%zu", memory_names[k],
+                 memory.bytes[k], memory_names[k], memory.reserved[k]);
+  for (int p = 0; perf_counting && p < PHASES; p++)
+    for (int k = 0; k < PERF_COUNTERS; k++)
+      if (perf_available(k))
+        write_format(w, ",\"%s_%s\":%llu", phase_names[p], perf_names[k],
+                     (unsigned long long)stats.events[p][k]);
+  write_format(w, ",\"peak_rss_kb\":%zu}\n", peak_rss());
+  if (to_stdout)
+    return true;
+  bool ok = (record.fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0666)) >= 0;
+  if (ok)
+    flush_writer(record);
+  record.size = 0;
+  delete_writer(record);
+  return ok && !close(record.fd);
+}
+
+#endif
@@ -0,0 +1,105 @@
+// Chrome trace event output shared by 'one_symmetry' and 'two_symmetry'.
+//
+// With '--trace <file>' phases and expensive single checks are recorded
+// as complete ('X') events and written at the end in the JSON format read
+// by 'chrome://tracing' and Perfetto.  Single checks are only recorded if
+// they take at least '--trace-threshold=<us>' microseconds.  Without
+// '--trace' the instrumented code only tests 'trace_path'.
+
+#ifndef _trace_hpp_INCLUDED
+#define _trace_hpp_INCLUDED
+
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "output.hpp"
+
+static const char *trace_path;    // Trace written to this file.
+static int trace_threshold = 100; // Minimum duration of single checks.
+
+struct Trace_event
+{
+  std::string name;
+  const char *category;
+  double start, duration; // Microseconds.
+  int tid;
+};
+
+static std::vector<Trace_event> trace_events;
+static std::mutex trace_lock;
+static std::atomic<int> trace_threads;
+static thread_local int trace_tid = -1;
+
+static inline double trace_clock(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return 1e6 * ts.tv_sec + 1e-3 * ts.tv_nsec;
+}
+
+static const double trace_origin = trace_clock();
+
+static inline void add_trace_event(std::string name, const char *category,
+                                   double start, double duration)
+{
+  if (trace_tid < 0)
+    trace_tid = trace_threads++;
+  std::lock_guard<std::mutex> lock(trace_lock);
+  trace_events.push_back(
+      {std::move(name), category, start - trace_origin, duration, trace_tid});
+}
+
+// Record a single check started at 'start' if it took long enough.
+
+static inline void trace_check(double start, const char *category,
+                               const char *fmt, ...)
+{
+  double duration = trace_clock() - start;
+  if (duration < trace_threshold)
+    return;
+  char name[128];
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(name, sizeof name, fmt, ap);
+  va_end(ap);
+  add_trace_event(name, category, start, duration);
+}
+
+static inline bool write_trace(void)
+{
+  Writer w = {-1, 0, 0, 0, 0, false, 0, 0};
+  if ((w.fd = open(trace_path, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0)
+    return false;
+  write_string(w, "{\"traceEvents\":[");
+  const char *separator = "\n";
+  for (auto &event : trace_events)
+  {
+    write_string(w, separator);
+    write_string(w, "{\"name\":\"");
+    for (auto ch : event.name)
+    {
+      if (ch == '"' || ch == '\\')
+        write_char(w, '\\');
+      if ((unsigned char)ch >= 0x20)
+        write_char(w, ch);
+    }
+    write_format(w,
+                 "\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                 "\"pid\":1,\"tid\":%d}",
+                 event.category, event.start, event.duration, event.tid);
+    separator = ",\n";
+  }
+  write_string(w, "\n],\"displayTimeUnit\":\"ms\"}\n");
+  delete_writer(w);
+  return !close(w.fd);
+}
+
+#endif
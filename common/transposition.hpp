@@ -0,0 +1,885 @@
+// Interchangeable variables and literal permutations, the engine of
+// 'two_symmetry'.
+//
+// A transposition 'var1 <-> var2' (or in phase mode 'var1 <-> -var2')
+// maps the formula onto itself.  Pairs are checked exhaustively (with
+// '--sorting' only within buckets of equal occurrence counts) or proposed
+// by locality-sensitive hashing and merged to groups.  Rows of variables
+// are permutations of whole clauses and 'automorphism.hpp' searches
+// general ones.  All state of a search is kept in a 'Transposition_search'
+// on a 'Formula' (see 'formula.hpp'), which the tool and
+// 'lib/symmetry.cpp' keep as their context.
+//
+// Detection stops early (keeping what was found so far) after the time
+// limit, the pair budget or on an interrupt, and the search is then marked
+// as incomplete.  The limits are polled cooperatively by the search loops.
+
+#ifndef _transposition_hpp_INCLUDED
+#define _transposition_hpp_INCLUDED
+
+#include <algorithm>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "formula.hpp"
+#include "kernels.hpp"
+#include "memory.hpp"
+#include "profile.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+
+struct Transposition_options
+{
+  bool sorting; // check only pairs with the same occurrence counts
+  bool groups;  // merge interchangeable pairs to groups
+  bool phase;   // also check phase-shifted transpositions 'a <-> -b'
+
+  bool lsh;      // propose candidate pairs by MinHash instead of all pairs
+  int lsh_bands; // more bands: only more false candidates
+  int lsh_rows;  // more rows per band: fewer false candidates
+
+  int time_limit;  // seconds per instance, zero means unlimited
+  int pair_budget; // considered pairs, zero means unlimited
+  const volatile sig_atomic_t *interrupted; // Stops detection if set.
+
+  int aut_node_limit; // zero means unlimited
+  int aut_time_limit; // seconds, zero means unlimited
+
+  bool account_memory; // note the memory of temporary arrays
+
+  // Results are added through these, which for instance write them
+  // immediately in streaming mode.  Row symmetries and other generators
+  // are told apart by 'row'.
+
+  void (*found_symmetry)(const std::vector<int> &sym);
+  void (*found_generator)(const std::vector<int> &generator, bool row);
+};
+
+// Cell split of the automorphism search (see 'automorphism.hpp').
+
+struct Split
+{
+  int parent; // Start of the cell split.
+  int start;  // Start of the piece cut off.
+  int end;    // End of the parent before the cut.
+};
+
+struct Transposition_search
+{
+  Formula *formula;
+  const Transposition_options *options;
+
+  std::vector<std::vector<int>> symmetries;
+  std::vector<int> sorted; // Variables in the order pairs are checked.
+
+  // Permutations other than single transpositions are stored as
+  // generators, a flat list of pairs 'var, image' over the positive
+  // variables moved.
+
+  std::vector<std::vector<int>> generators;
+  size_t row_groups;
+  std::vector<std::vector<int>> aut_generators;
+
+  std::vector<int> images; // Storage of 'permutation'.
+  int *permutation;        // Maps every literal to its image.
+  std::vector<char> seen;  // Per variable flags walking cycles.
+
+  size_t checked_pairs;    // Variable pairs considered.
+  size_t exhaustive_pairs; // Pairs of exhaustive search.
+  size_t lsh_candidates;   // Candidate pairs proposed by LSH.
+  size_t lsh_limited;      // LSH buckets exceeding 'lsh_window'.
+
+  double start_time; // Wall-clock time the instance started.
+  size_t budget_polls;
+  const char *incomplete; // Reason or zero if complete.
+
+  // State of the automorphism search, with literal vertices first and
+  // clause vertices after them.
+
+  int aut_vertices;
+  std::vector<int> lab;       // Vertices ordered by cell.
+  std::vector<int> cell_of;   // Start of vertex cell.
+  std::vector<int> cell_end;  // End of cell at position.
+  std::vector<int> counts;    // Adjacency counts.
+  std::vector<char> queued;   // Cells in splitter queue.
+  std::vector<int> splitters; // Splitter queue.
+  std::vector<Split> splits;  // Splits to undo.
+  int cells;                  // Number of cells.
+
+  std::vector<int> lab_pos;  // Vertex position in 'lab'.
+  std::vector<int> leaf_pos; // Position in first leaf.
+  std::vector<int> orbit;    // Union-find of vertices.
+
+  size_t aut_nodes;
+  size_t aut_depth; // Levels of the first path.
+  bool aut_incomplete;
+  double aut_start_time;
+};
+
+static inline bool anytime_limits(const Transposition_search &s)
+{
+  return s.options->time_limit || s.options->pair_budget;
+}
+
+static inline bool interrupt_requested(const Transposition_search &s)
+{
+  return s.options->interrupted && *s.options->interrupted;
+}
+
+static inline bool out_of_time(Transposition_search &s)
+{
+  if (s.incomplete)
+    return true;
+  int time_limit = s.options->time_limit;
+  if (interrupt_requested(s))
+    s.incomplete = "interrupt";
+  else if (time_limit && wall_clock_time() - s.start_time >= time_limit)
+    s.incomplete = "time limit";
+  return s.incomplete;
+}
+
+// Called for every LSH candidate, thus the clock is only polled rarely.
+
+static inline bool out_of_budget(Transposition_search &s)
+{
+  if (s.incomplete)
+    return true;
+  int pair_budget = s.options->pair_budget;
+  if (pair_budget && s.checked_pairs >= (size_t)pair_budget)
+    s.incomplete = "pair budget";
+  else if (interrupt_requested(s) || !(++s.budget_polls & 1023))
+    out_of_time(s);
+  return s.incomplete;
+}
+
+// The exhaustive search counts the pairs of a variable at once and thus
+// only checks its limits once per variable.  Returns the end of the pairs
+// of the variable at position 'i' within the remaining pair budget, or
+// zero if the search has to stop.
+
+static inline int pairs_end(Transposition_search &s, int i, int variables)
+{
+  if (out_of_time(s))
+    return 0;
+  size_t pair_budget = s.options->pair_budget;
+  if (!pair_budget)
+    return variables;
+  if (s.checked_pairs >= pair_budget)
+  {
+    s.incomplete = "pair budget";
+    return 0;
+  }
+  size_t left = pair_budget - s.checked_pairs;
+  return left < (size_t)(variables - i - 1) ? i + 1 + (int)left : variables;
+}
+
+static inline void found_symmetry(Transposition_search &s,
+                                  const std::vector<int> &sym)
+{
+  s.symmetries.push_back(sym);
+  if (s.options->found_symmetry)
+    s.options->found_symmetry(sym);
+}
+
+static inline void found_generator(Transposition_search &s,
+                                   std::vector<std::vector<int>> &list,
+                                   const std::vector<int> &generator)
+{
+  list.push_back(generator);
+  if (s.options->found_generator)
+    s.options->found_generator(generator, &list == &s.generators);
+}
+
+static inline bool check_symmetry(Transposition_search &s, int var1, int var2)
+{
+  auto &var1_occs = s.formula->matrix[var1];
+  auto &var2_occs = s.formula->matrix[var2];
+  for (size_t i = 0; i < var1_occs.size(); i++)
+  {
+    bool found = false;
+    for (size_t j = i; j < var2_occs.size(); j++)
+    {
+      if (transposition_kernel(var1_occs[i], var2_occs[j], var1, var2))
+      {
+        found = true;
+        stats.swaps += i != j;
+        // after finding a matching clause, move it back
+        // so only unmatched clauses have to be considered
+        Clause *tmp = var2_occs[i];
+        var2_occs[i] = var2_occs[j];
+        var2_occs[j] = tmp;
+        break;
+      }
+    }
+    if (!found)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Unused variables are skipped, but variables occurring only negatively
+// are interchangeable with others as well.
+
+static inline bool occurs(const Transposition_search &s, int var)
+{
+  auto matrix = s.formula->matrix;
+  return matrix[var].size() != 0 || matrix[-var].size() != 0;
+}
+
+// A transposition 'var1 <-> var2' requires the same number of positive
+// and negative occurrences, a phase-shifted one 'var1 <-> -var2' pairs the
+// positive occurrences of one with the negative ones of the other.
+
+static inline bool same_occurrences(const Transposition_search &s, int var1,
+                                    int var2)
+{
+  auto matrix = s.formula->matrix;
+  return matrix[var1].size() == matrix[var2].size() &&
+         matrix[-var1].size() == matrix[-var2].size();
+}
+
+static inline bool candidate_pair(const Transposition_search &s, int var1,
+                                  int var2)
+{
+  return same_occurrences(s, var1, var2) ||
+         (s.options->phase && same_occurrences(s, var1, -var2));
+}
+
+// Returns 'var2' if 'var1 <-> var2' is a symmetry, '-var2' if (in phase
+// mode) 'var1 <-> -var2' is one and zero otherwise.
+
+static inline int check_pair(Transposition_search &s, int var1, int var2)
+{
+  auto matrix = s.formula->matrix;
+  double start = trace_path || profile_top ? trace_clock() : 0;
+  uint64_t comparisons = stats.clause_comparisons;
+  int res = 0;
+  if (same_occurrences(s, var1, var2) && check_symmetry(s, var1, var2) &&
+      check_symmetry(s, -var1, -var2))
+    res = var2;
+  else if (s.options->phase && same_occurrences(s, var1, -var2) &&
+           check_symmetry(s, var1, -var2) && check_symmetry(s, -var1, var2))
+    res = -var2;
+  if (trace_path)
+    trace_check(start, "check", "check %d %d", var1, var2);
+  if (profile_top)
+    profile_check(var1, matrix[var1].size() + matrix[-var1].size(), var2,
+                  matrix[var2].size() + matrix[-var2].size(),
+                  stats.clause_comparisons - comparisons, start);
+  return res;
+}
+
+// Start the search on the formula, with the variables in their order.
+
+static inline void start_search(Transposition_search &s)
+{
+  const int variables = s.formula->variables;
+  s.sorted.resize(variables);
+  for (int i = 1; i <= variables; i++)
+    s.sorted[i - 1] = i;
+  s.exhaustive_pairs = (size_t)variables * (variables - (variables > 0)) / 2;
+}
+
+static inline void sort_variables(Transposition_search &s)
+{
+  Phase_scope scope(FILTER);
+  auto matrix = s.formula->matrix;
+  const bool phase = s.options->phase;
+  const int variables = s.formula->variables;
+  int *sorted_variables = s.sorted.data();
+  // In phase mode both kinds of candidate pairs need to end up next to
+  // each other, thus the number of occurrences is compared unordered.
+  auto key = [&](int var)
+  {
+    size_t pos = matrix[var].size(), neg = matrix[-var].size();
+    if (phase && pos > neg)
+      return std::make_pair(neg, pos);
+    return std::make_pair(pos, neg);
+  };
+  std::sort(sorted_variables, sorted_variables + variables, [&](int i, int j)
+            { return key(i) < key(j); });
+  if (!anytime_limits(s))
+    return;
+
+  // Under a time limit or pair budget the buckets of variables with the
+  // same occurrence counts are checked in the order of their expected
+  // yield per checked pair.  A group of interchangeable variables mostly
+  // fills a bucket on its own, thus small buckets (few pairs) come first,
+  // ties broken by the cost of a check (few occurrences), and buckets
+  // without any potential partner (including unused variables) last.
+
+  struct Bucket
+  {
+    size_t pairs, cost;
+    int start, end;
+  };
+  std::vector<Bucket> buckets;
+  for (int l = 0, r; l < variables; l = r)
+  {
+    auto counts = key(sorted_variables[l]);
+    for (r = l + 1; r < variables && key(sorted_variables[r]) == counts; r++)
+      ;
+    size_t m = r - l, cost = counts.first + counts.second;
+    size_t pairs = m > 1 && cost ? m * (m - 1) / 2 : SIZE_MAX;
+    buckets.push_back({pairs, cost, l, r});
+  }
+  std::stable_sort(buckets.begin(), buckets.end(),
+                   [](const Bucket &a, const Bucket &b)
+                   { return a.pairs != b.pairs ? a.pairs < b.pairs
+                                               : a.cost < b.cost; });
+  std::vector<int> ordered;
+  ordered.reserve(variables);
+  for (auto &bucket : buckets)
+    ordered.insert(ordered.end(), sorted_variables + bucket.start,
+                   sorted_variables + bucket.end);
+  std::copy(ordered.begin(), ordered.end(), sorted_variables);
+}
+
+// Candidate pairs are filtered by their occurrence counts while checking,
+// thus the exhaustive search is timed as a whole as 'check' phase.  With
+// sorted variables a bucket is a run of variables with the same occurrence
+// counts (as the LSH bands in 'find_lsh_symmetries'), otherwise the pairs
+// of a single variable, and each bucket is traced as one event.
+
+static inline void find_symmetries(Transposition_search &s)
+{
+  Phase_scope scope(CHECK);
+  auto matrix = s.formula->matrix;
+  const int variables = s.formula->variables;
+  const bool sorted = s.options->sorting || anytime_limits(s);
+  int *sorted_variables = s.sorted.data();
+  for (int i = 0; i < variables && !s.incomplete;)
+  {
+    double start = trace_path ? trace_clock() : 0;
+    int first = sorted_variables[i], end = i + 1;
+    if (sorted)
+      while (end < variables &&
+             candidate_pair(s, first, sorted_variables[end]))
+        end++;
+    const int size = end - i;
+    for (int last; i < end && (last = pairs_end(s, i, variables)); i++)
+    {
+      int var1 = sorted_variables[i];
+      std::vector<int> group = {var1};
+      const int from = i + 1;
+      int j = from;
+      for (; j < last; j++)
+      {
+        int var2 = sorted_variables[j];
+        if (occurs(s, var1) && candidate_pair(s, var1, var2))
+        {
+          if (int lit2 = check_pair(s, var1, var2))
+          {
+            if (s.options->groups)
+            {
+              group.push_back(lit2);
+              int tmp = sorted_variables[i+1];
+              sorted_variables[i+1] = sorted_variables[j];
+              sorted_variables[j] = tmp;
+              i++;
+            } else {
+              found_symmetry(s, {var1, lit2});
+            }
+          }
+        }
+        else if(sorted)
+        {
+          break;
+        }
+      }
+      s.checked_pairs += j - from + (j < last); // Including a break.
+      if (group.size() > 1) {
+        found_symmetry(s, group);
+      }
+    }
+    if (trace_path && sorted)
+      trace_check(start, "bucket", "bucket of %d variables %zu+%zu occurrences",
+                  size, matrix[first].size(), matrix[-first].size());
+    else if (trace_path)
+      trace_check(start, "bucket", "pairs of %d", first);
+  }
+}
+
+// Locality-sensitive candidate pairing for huge formulas.  Two variables
+// can only be interchangeable if the clauses they occur in agree apart
+// from the two variables themselves, so the MinHash sketches of their
+// neighborhoods (the co-occurring literals with the pivot masked out)
+// agree.  Each sketch is cut into 'lsh_bands' bands of 'lsh_rows' hash
+// values and only variables which agree on a whole band (and on the number
+// of occurrences) are checked exactly.  Interchangeable variables have
+// the same sketch and thus agree on every band.  More bands therefore only
+// add false candidates, while more rows per band make agreement stricter
+// for other variables at the cost of computing more hash values.
+
+static inline void compute_sketch(const Transposition_search &s, int var,
+                                  const std::vector<uint64_t> &seeds,
+                                  uint64_t *sketch)
+{
+  auto matrix = s.formula->matrix;
+  const size_t hashes = seeds.size();
+  for (size_t k = 0; k < hashes; k++)
+    sketch[k] = UINT64_MAX;
+  for (int lit : {var, -var})
+  {
+    for (auto c : matrix[lit])
+    {
+      for (auto other : *c)
+      {
+        if (abs(other) == var)
+          continue;
+        // A potential partner of the pivot has the same number of
+        // occurrences and is masked as well, keeping only its phase
+        // relative to the pivot.  Otherwise pairs occurring mostly
+        // together never collide.
+        uint64_t neighbor = (uint32_t)other;
+        if (candidate_pair(s, abs(lit), abs(other)))
+          neighbor = (uint64_t)1 << 32 | ((other > 0) == (lit > 0));
+        // Neighbors are tagged with the phase of the pivot they occur with,
+        // which phase-shifted transpositions do not preserve.
+        bool tag = !s.options->phase && lit > 0;
+        uint64_t feature = mix_hash(2 * neighbor + tag);
+        for (size_t k = 0; k < hashes; k++)
+        {
+          uint64_t h = mix_hash(feature ^ seeds[k]);
+          if (h < sketch[k])
+            sketch[k] = h;
+        }
+      }
+    }
+  }
+}
+
+static inline int find_root(std::vector<int> &parent, int var)
+{
+  while (parent[var] != var)
+  {
+    parent[var] = parent[parent[var]];
+    var = parent[var];
+  }
+  return var;
+}
+
+// Members of a bucket are only paired with the next 'lsh_window' members,
+// which bounds the pairs of huge buckets (e.g., of many variables with
+// the same few occurrences) at the cost of missing some of their pairs.
+
+static const size_t lsh_window = 256;
+
+// Whether 'band' is the first band in which the keys of the variables at
+// positions 'i' and 'j' agree, thus every candidate pair is checked once.
+
+static inline bool first_collision(const uint64_t *keys, size_t bands,
+                                   size_t i, size_t j, size_t band)
+{
+  for (size_t b = 0; b < band; b++)
+    if (keys[i * bands + b] == keys[j * bands + b])
+      return false;
+  return true;
+}
+
+// Exact verification, where interchangeable pairs are merged to groups.
+
+static inline void check_lsh_pair(Transposition_search &s,
+                                  std::vector<int> &parent, int var1,
+                                  int var2)
+{
+  s.checked_pairs++;
+  if (int lit2 = check_pair(s, var1, var2))
+  {
+    if (s.options->groups)
+    {
+      // Phase-shifted pairs are kept in their own group.
+      if (lit2 > 0)
+        parent[find_root(parent, var2)] = find_root(parent, var1);
+      else
+        found_symmetry(s, {var1, lit2});
+    }
+    else
+    {
+      found_symmetry(s, {var1, lit2});
+    }
+  }
+}
+
+static inline void find_lsh_symmetries(Transposition_search &s)
+{
+  Phase_scope scope(FILTER);
+  auto matrix = s.formula->matrix;
+  const int variables = s.formula->variables;
+  std::vector<int> vars;
+  for (int var = 1; var <= variables; var++)
+  {
+    if (occurs(s, var))
+    {
+      vars.push_back(var);
+    }
+  }
+  const size_t n = vars.size();
+  const size_t bands = s.options->lsh_bands;
+  const size_t rows = s.options->lsh_rows;
+
+  std::vector<uint64_t> seeds(bands * rows);
+  for (size_t k = 0; k < seeds.size(); k++)
+    seeds[k] = mix_hash(k);
+
+  std::vector<uint64_t> sketch(bands * rows);
+  std::vector<uint64_t> keys(n * bands);
+  for (size_t i = 0; i < n; i++)
+  {
+    int var = vars[i];
+    compute_sketch(s, var, seeds, sketch.data());
+    for (size_t b = 0; b < bands; b++)
+    {
+      size_t pos = matrix[var].size(), neg = matrix[-var].size();
+      if (s.options->phase && pos > neg)
+        std::swap(pos, neg);
+      uint64_t key = mix_hash(b);
+      key = mix_hash(key ^ pos);
+      key = mix_hash(key ^ neg);
+      for (size_t r = 0; r < rows; r++)
+        key = mix_hash(key ^ sketch[b * rows + r]);
+      keys[i * bands + b] = key;
+    }
+  }
+
+  // Variables with the same key in some band are candidate pairs, which
+  // are checked right away in the first band they collide in.
+
+  scope.switch_to(CHECK);
+
+  std::vector<int> parent(variables + 1);
+  for (int var = 0; var <= variables; var++)
+    parent[var] = var;
+
+  std::vector<std::pair<uint64_t, int>> bucket(n);
+
+  if (s.options->account_memory)
+  {
+    Memory_sum scratch;
+    scratch.add(vars), scratch.add(seeds), scratch.add(sketch);
+    scratch.add(keys), scratch.add(bucket), scratch.add(parent);
+    note_memory(SCRATCH_MEMORY, scratch);
+  }
+
+  for (size_t b = 0; b < bands && !s.incomplete; b++)
+  {
+    double start = trace_path ? trace_clock() : 0;
+    for (size_t i = 0; i < n; i++)
+      bucket[i] = {keys[i * bands + b], (int)i};
+    std::sort(bucket.begin(), bucket.end());
+    for (size_t l = 0, r; l < n && !s.incomplete; l = r)
+    {
+      for (r = l + 1; r < n && bucket[r].first == bucket[l].first; r++)
+        ;
+      if (r - l > lsh_window + 1)
+        s.lsh_limited++;
+      for (size_t x = l; x < r && !s.incomplete; x++)
+        for (size_t y = x + 1; y < r && y <= x + lsh_window; y++)
+        {
+          const int i = bucket[x].second, j = bucket[y].second;
+          if (!first_collision(keys.data(), bands, i, j, b))
+            continue;
+          if (out_of_budget(s))
+            break;
+          s.lsh_candidates++;
+          check_lsh_pair(s, parent, vars[i], vars[j]);
+        }
+    }
+    if (trace_path)
+      trace_check(start, "bucket", "lsh band %zu", b);
+  }
+
+  if (s.options->groups)
+  {
+    std::vector<std::vector<int>> members(variables + 1);
+    for (auto var : vars)
+      members[find_root(parent, var)].push_back(var);
+    for (auto var : vars)
+    {
+      auto &group = members[find_root(parent, var)];
+      if (group.size() > 1 && group[0] == var)
+      {
+        found_symmetry(s, group);
+      }
+    }
+  }
+}
+
+// General permutations are checked by applying them to every clause with
+// a moved literal and looking for the image among the occurrences of its
+// first literal.  The 'permutation' array is the identity except while a
+// generator is set.
+
+static inline void init_permutation(Transposition_search &s)
+{
+  const int variables = s.formula->variables;
+  s.images.resize(2 * (size_t)variables + 1);
+  s.permutation = s.images.data() + variables;
+  for (int lit = -variables; lit <= variables; lit++)
+    s.permutation[lit] = lit;
+  s.seen.assign(variables + 1, 0);
+}
+
+static inline void set_permutation(Transposition_search &s,
+                                   const std::vector<int> &generator)
+{
+  for (size_t i = 0; i < generator.size(); i += 2)
+  {
+    s.permutation[generator[i]] = generator[i + 1];
+    s.permutation[-generator[i]] = -generator[i + 1];
+  }
+}
+
+static inline void reset_permutation(Transposition_search &s,
+                                     const std::vector<int> &generator)
+{
+  for (size_t i = 0; i < generator.size(); i += 2)
+  {
+    s.permutation[generator[i]] = generator[i];
+    s.permutation[-generator[i]] = -generator[i];
+  }
+}
+
+// check whether the second clause is the image of the first one under the
+// current permutation
+static inline bool check_clause_permutation(Transposition_search &s,
+                                            Clause *c1, Clause *c2)
+{
+  const int *permutation = s.permutation;
+  stats.clause_comparisons++;
+  if (c1->size != c2->size)
+  {
+    stats.early_rejects++;
+    return false;
+  }
+
+  auto c1_literals = c1->literals;
+  auto c2_literals = c2->literals;
+
+  // a clause mapped onto itself must not be reordered while matching
+  if (c1 == c2)
+  {
+    for (auto lit : *c1)
+    {
+      if (std::find(c1->begin(), c1->end(), permutation[lit]) == c1->end())
+        return false;
+    }
+    return true;
+  }
+
+  for (unsigned i = 0; i < c1->size; i++)
+  {
+    int image = permutation[c1_literals[i]];
+    bool found = false;
+    for (unsigned j = i; j < c2->size; j++)
+    {
+      stats.literal_comparisons++;
+      if (image == c2_literals[j])
+      {
+        // after finding a matching literal, move it back
+        // so only unmatched literals have to be considered
+        found = true;
+        stats.swaps += i != j;
+        int tmp = c2_literals[i];
+        c2_literals[i] = c2_literals[j];
+        c2_literals[j] = tmp;
+        break;
+      }
+    }
+    if (!found)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+static inline bool check_permutation(Transposition_search &s,
+                                     const std::vector<int> &generator)
+{
+  auto matrix = s.formula->matrix;
+  std::vector<Clause *> moved;
+  for (size_t i = 0; i < generator.size(); i += 2)
+  {
+    for (int lit : {generator[i], -generator[i]})
+      moved.insert(moved.end(), matrix[lit].begin(), matrix[lit].end());
+  }
+  std::sort(moved.begin(), moved.end());
+  moved.erase(std::unique(moved.begin(), moved.end()), moved.end());
+
+  set_permutation(s, generator);
+  bool res = true;
+  for (auto c1 : moved)
+  {
+    bool found = false;
+    for (auto c2 : matrix[s.permutation[c1->literals[0]]])
+    {
+      if (check_clause_permutation(s, c1, c2))
+      {
+        found = true;
+        break;
+      }
+    }
+    if (!found)
+    {
+      res = false;
+      break;
+    }
+  }
+  reset_permutation(s, generator);
+  return res;
+}
+
+// Generator mapping the literals of one row to the literals of the other
+// at the same position and vice versa.
+
+static inline std::vector<int> row_swap(const std::vector<int> &row1,
+                                        const std::vector<int> &row2)
+{
+  std::vector<int> generator;
+  for (size_t k = 0; k < row1.size(); k++)
+  {
+    int sign1 = row1[k] < 0 ? -1 : 1;
+    int sign2 = row2[k] < 0 ? -1 : 1;
+    generator.push_back(abs(row1[k]));
+    generator.push_back(sign1 * row2[k]);
+    generator.push_back(abs(row2[k]));
+    generator.push_back(sign2 * row1[k]);
+  }
+  return generator;
+}
+
+// Matrix-structured encodings (pigeonhole, scheduling, coloring) are
+// symmetric under swapping whole rows of variables.  Candidate rows are
+// variable disjoint clauses with the same signature (size and occurrence
+// counts of their literals), e.g. the 'pigeon i sits in some hole' clauses.
+// Members of two rows are matched in increasing variable order, as these
+// encodings number their variables row by row.
+
+static inline void find_row_symmetries(Transposition_search &s)
+{
+  Phase_scope scope(CHECK);
+  auto matrix = s.formula->matrix;
+  const auto &clauses = s.formula->clauses;
+  auto &seen = s.seen;
+  std::vector<std::pair<uint64_t, size_t>> keyed;
+  for (size_t i = 0; i < clauses.size(); i++)
+  {
+    Clause *c = clauses[i];
+    if (c->size < 2)
+      continue;
+    uint64_t key = mix_hash(c->size);
+    for (auto lit : *c)
+      key += mix_hash(mix_hash(matrix[lit].size()) ^ matrix[-lit].size());
+    keyed.push_back({key, i});
+  }
+  std::sort(keyed.begin(), keyed.end());
+
+  std::vector<std::vector<int>> family;
+  for (size_t l = 0, r; l < keyed.size() && !out_of_time(s); l = r)
+  {
+    for (r = l + 1; r < keyed.size() && keyed[r].first == keyed[l].first; r++)
+      ;
+    if (r - l < 2)
+      continue;
+
+    family.clear();
+    for (size_t i = l; i < r; i++)
+    {
+      std::vector<int> row(clauses[keyed[i].second]->begin(),
+                           clauses[keyed[i].second]->end());
+      std::sort(row.begin(), row.end(), [](int i, int j)
+                { return abs(i) < abs(j); });
+      bool disjoint = true;
+      for (size_t k = 0; disjoint && k < row.size(); k++)
+        disjoint = !seen[abs(row[k])] && (!k || abs(row[k - 1]) != abs(row[k]));
+      if (!disjoint)
+        continue;
+      for (auto lit : row)
+        seen[abs(lit)] = true;
+      family.push_back(row);
+    }
+    for (auto &row : family)
+      for (auto lit : row)
+        seen[abs(lit)] = false;
+
+    std::vector<char> grouped(family.size());
+    for (size_t i = 0; i < family.size(); i++)
+    {
+      if (grouped[i])
+        continue;
+      size_t last = i;
+      for (size_t j = i + 1; j < family.size(); j++)
+      {
+        if (grouped[j] ||
+            !check_permutation(s, row_swap(family[i], family[j])))
+          continue;
+        // All rows interchangeable with the first one are interchangeable
+        // with each other, so swapping neighbors generates the group.
+        found_generator(s, s.generators, row_swap(family[last], family[j]));
+        grouped[j] = true;
+        last = j;
+      }
+      if (last != i)
+        s.row_groups++;
+    }
+  }
+}
+
+// Number of transpositions (within groups) and generators found.
+
+static inline size_t symmetries_found(const Transposition_search &s)
+{
+  size_t found = s.generators.size() + s.aut_generators.size();
+  for (auto &sym : s.symmetries)
+    found += sym.size() * (sym.size() - 1) / 2;
+  return found;
+}
+
+// Note the memory of the search (see 'memory.hpp').
+
+static inline void account_memory(const Transposition_search &s)
+{
+  Memory_sum candidate_memory;
+  candidate_memory.add(s.sorted);
+  for (auto *lists : {&s.symmetries, &s.generators, &s.aut_generators})
+  {
+    candidate_memory.add(*lists);
+    for (auto &list : *lists)
+      candidate_memory.add(list);
+  }
+  note_memory(CANDIDATE_MEMORY, candidate_memory);
+
+  Memory_sum scratch;
+  scratch.add(s.images), scratch.add(s.seen);
+  scratch.add(s.lab), scratch.add(s.cell_of), scratch.add(s.cell_end);
+  scratch.add(s.counts), scratch.add(s.queued), scratch.add(s.splitters);
+  scratch.add(s.splits), scratch.add(s.lab_pos), scratch.add(s.leaf_pos);
+  scratch.add(s.orbit);
+  note_memory(SCRATCH_MEMORY, scratch);
+}
+
+// Clear the search but keep its memory.
+
+static inline void reset_search(Transposition_search &s)
+{
+  s.symmetries.clear();
+  s.generators.clear();
+  s.aut_generators.clear();
+  s.row_groups = 0;
+  s.checked_pairs = s.exhaustive_pairs = s.lsh_candidates = 0;
+  s.lsh_limited = 0;
+  s.splits.clear();
+  s.splitters.clear();
+  s.aut_nodes = s.aut_depth = 0;
+  s.aut_incomplete = false;
+  s.budget_polls = 0;
+  s.incomplete = 0;
+}
+
+#endif
@@ -0,0 +1,265 @@
+// Reentrant detection core of 'symmetry.h'.
+//
+// The library runs the engines of 'one_symmetry' and 'two_symmetry'
+// ('common/negation.hpp' and 'common/transposition.hpp') on a formula and
+// searches kept in the context instead of thread local variables.
+//
+// Buffers of 'symmetry_add_clauses' are borrowed, only their position is
+// stored.  Every detection copies the added clauses once into the clause
+// arena of the formula (see 'common/formula.hpp'), since the kernels and
+// sorting reorder literals and '--fixpoint' removes them, and the caller
+// buffers are never written.  The arena is reused by later detections.
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "../common/formula.hpp"
+#include "../common/negation.hpp"
+#include "../common/transposition.hpp"
+#include "symmetry.h"
+
+// Added clauses in a borrowed buffer or in 'literals' of the context.
+
+struct Segment
+{
+  const int *borrowed; // Caller buffer or zero for 'literals'.
+  size_t start, size;  // Position in 'literals' and number of integers.
+};
+
+struct symmetry_context
+{
+  std::vector<Segment> segments; // Added clauses in order.
+  std::vector<int> literals;     // Clauses of 'symmetry_add_clause'.
+  size_t size = 0; // Added integers including terminating zeros.
+  size_t clauses = 0;
+  int variables = 0;
+
+  // Formula and searches of the last detection, reset but not freed by
+  // the next one.
+
+  Formula formula = {};
+  Negation_options negation_options = {};
+  Negation_search negation = {};
+  Transposition_options transposition_options = {};
+  Transposition_search transposition = {};
+
+  std::vector<int> result;
+  symmetry_statistics statistics = {};
+
+  ~symmetry_context() { release_formula(formula); }
+};
+
+// Variables have to be below 'INT_MAX' (see 'initialize_formula').
+
+static bool valid_literal(int lit)
+{
+  return lit && lit > -INT_MAX && lit < INT_MAX;
+}
+
+symmetry_context *symmetry_new(void)
+{
+  return new (std::nothrow) symmetry_context;
+}
+
+void symmetry_delete(symmetry_context *ctx) { delete ctx; }
+
+void symmetry_reset(symmetry_context *ctx)
+{
+  ctx->segments.clear();
+  ctx->literals.clear();
+  ctx->size = 0;
+  ctx->clauses = 0;
+  ctx->variables = 0;
+}
+
+int symmetry_add_clause(symmetry_context *ctx, const int *literals,
+                        size_t size)
+{
+  for (size_t i = 0; i < size; i++)
+    if (!valid_literal(literals[i]))
+      return 1;
+  try
+  {
+    // Consecutive single clauses extend the last segment.
+    size_t start = ctx->literals.size();
+    if (ctx->segments.empty() || ctx->segments.back().borrowed)
+      ctx->segments.push_back({0, start, 0});
+    ctx->literals.insert(ctx->literals.end(), literals, literals + size);
+    ctx->literals.push_back(0);
+    ctx->segments.back().size += size + 1;
+  }
+  catch (std::bad_alloc &)
+  {
+    return 1;
+  }
+  for (size_t i = 0; i < size; i++)
+    ctx->variables = std::max(ctx->variables, abs(literals[i]));
+  ctx->size += size + 1;
+  ctx->clauses++;
+  return 0;
+}
+
+size_t symmetry_add_clauses(symmetry_context *ctx, const int *literals,
+                            size_t size)
+{
+  if (size && literals[size - 1])
+    return SYMMETRY_ERROR;
+  size_t clauses = 0;
+  int variables = ctx->variables;
+  for (size_t i = 0; i < size; i++)
+  {
+    if (!literals[i])
+      clauses++;
+    else if (!valid_literal(literals[i]))
+      return SYMMETRY_ERROR;
+    else
+      variables = std::max(variables, abs(literals[i]));
+  }
+  if (!size)
+    return 0;
+  try
+  {
+    ctx->segments.push_back({literals, 0, size});
+  }
+  catch (std::bad_alloc &)
+  {
+    return SYMMETRY_ERROR;
+  }
+  ctx->size += size;
+  ctx->variables = variables;
+  ctx->clauses += clauses;
+  return clauses;
+}
+
+// Copy the clauses to the formula and connect their literals.
+
+static void build_formula(symmetry_context *ctx)
+{
+  Formula &f = ctx->formula;
+  reset_formula(f);
+  initialize_formula(f, ctx->variables);
+  for (auto &segment : ctx->segments)
+  {
+    const int *literals = segment.borrowed ? segment.borrowed
+                                           : &ctx->literals[segment.start];
+    for (size_t i = 0, start = 0; i < segment.size; i++)
+    {
+      if (literals[i])
+        continue;
+      add_clause(f, literals + start, i - start);
+      start = i + 1;
+    }
+  }
+  build_index(f);
+}
+
+// Start and end of a detection, which copies the counters of the kernels.
+
+static void start_detection(symmetry_context *ctx)
+{
+  ctx->result.clear();
+  ctx->statistics = symmetry_statistics();
+  ctx->statistics.variables = ctx->variables;
+  ctx->statistics.clauses = ctx->clauses;
+  ctx->statistics.literals = ctx->size - ctx->clauses;
+  ctx->statistics.seconds = thread_time();
+  stats = Statistics();
+  build_formula(ctx);
+}
+
+static size_t finish_detection(symmetry_context *ctx, int *buffer,
+                               size_t capacity)
+{
+  ctx->statistics.seconds = thread_time() - ctx->statistics.seconds;
+  ctx->statistics.clause_comparisons = stats.clause_comparisons;
+  ctx->statistics.literal_comparisons = stats.literal_comparisons;
+  return symmetry_get_result(ctx, buffer, capacity);
+}
+
+size_t detect_negation_symmetries(symmetry_context *ctx,
+                                  const symmetry_negation_options *options,
+                                  int *variables, size_t capacity)
+{
+  Negation_options &opts = ctx->negation_options;
+  opts = Negation_options();
+  if (options)
+  {
+    opts.clause_swapping = options->clause_swapping;
+    opts.sort_clauses = options->sort_clauses;
+    opts.sort_literals = options->sort_literals;
+    opts.fixpoint = options->fixpoint;
+  }
+  Negation_search &search = ctx->negation;
+  try
+  {
+    start_detection(ctx);
+    reset_search(search);
+    search.formula = &ctx->formula;
+    search.options = &opts;
+    find_negation_symmetries(search);
+    ctx->result = search.symmetries;
+  }
+  catch (std::bad_alloc &)
+  {
+    return SYMMETRY_ERROR;
+  }
+  ctx->statistics.checked = search.checked;
+  ctx->statistics.found = search.symmetries.size();
+  return finish_detection(ctx, variables, capacity);
+}
+
+size_t detect_transpositions(symmetry_context *ctx,
+                             const symmetry_transposition_options *options,
+                             int *groups, size_t capacity)
+{
+  Transposition_options &opts = ctx->transposition_options;
+  opts = Transposition_options();
+  if (options)
+  {
+    opts.sorting = options->sorting;
+    opts.groups = options->groups;
+    opts.phase = options->phase;
+  }
+  Transposition_search &search = ctx->transposition;
+  try
+  {
+    start_detection(ctx);
+    reset_search(search);
+    search.formula = &ctx->formula;
+    search.options = &opts;
+    start_search(search);
+    if (opts.sorting)
+      sort_variables(search);
+    find_symmetries(search);
+    for (auto &group : search.symmetries)
+    {
+      ctx->result.insert(ctx->result.end(), group.begin(), group.end());
+      ctx->result.push_back(0);
+    }
+  }
+  catch (std::bad_alloc &)
+  {
+    return SYMMETRY_ERROR;
+  }
+  ctx->statistics.checked = search.checked_pairs;
+  ctx->statistics.found = symmetries_found(search);
+  return finish_detection(ctx, groups, capacity);
+}
+
+size_t symmetry_get_result(const symmetry_context *ctx, int *buffer,
+                           size_t capacity)
+{
+  size_t size = ctx->result.size();
+  std::copy(ctx->result.begin(),
+            ctx->result.begin() + std::min(size, capacity), buffer);
+  return size;
+}
+
+void symmetry_get_statistics(const symmetry_context *ctx,
+                             symmetry_statistics *statistics)
+{
+  *statistics = ctx->statistics;
+}
@@ -0,0 +1,124 @@
+// Embeddable symmetry detection of 'one_symmetry' and 'two_symmetry'.
+//
+// A context collects the clauses of a formula and runs the detection
+// engines of both tools on it in process, without any file I/O.  All
+// state lives in the context, so independent contexts can be used from
+// different threads at the same time (a single context can not).
+//
+//   symmetry_context *ctx = symmetry_new();
+//   int clause[] = {1, -2};
+//   symmetry_add_clause(ctx, clause, 2);
+//   ...
+//   int vars[64];
+//   size_t n = detect_negation_symmetries(ctx, 0, vars, 64);
+//
+// Results are written to caller owned buffers.  Detection functions
+// return the number of 'int' values of the complete result, of which only
+// the first 'capacity' are written, so a caller can retry with a larger
+// buffer.  Detection works on a copy of the clauses in memory of the
+// context (reused by the next detection), since it reorders and removes
+// literals.  It never changes the added clauses, thus it can be repeated
+// with other options.
+
+#ifndef _symmetry_h_INCLUDED
+#define _symmetry_h_INCLUDED
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct symmetry_context symmetry_context;
+
+// Returned by functions returning sizes on invalid input or out-of-memory.
+
+#define SYMMETRY_ERROR ((size_t)-1)
+
+symmetry_context *symmetry_new(void);
+void symmetry_delete(symmetry_context *);
+
+// Remove all clauses, keeping the allocated memory for the next formula.
+
+void symmetry_reset(symmetry_context *);
+
+// Add a clause of 'size' literals (non-zero DIMACS literals of absolute
+// value below 'INT_MAX'), which is copied.  Returns zero on success and
+// non-zero for invalid literals.
+
+int symmetry_add_clause(symmetry_context *, const int *literals,
+                        size_t size);
+
+// Add clauses given as a flat buffer of 'size' literals in which every
+// clause is terminated by zero (a DIMACS file without header).  Returns the
+// number of clauses added or 'SYMMETRY_ERROR' if a literal is invalid or
+// the last clause is not terminated, in which case nothing is added.
+//
+// The buffer is borrowed, not copied.  It has to stay valid and unchanged
+// until 'symmetry_reset' or 'symmetry_delete' of the context.
+
+size_t symmetry_add_clauses(symmetry_context *, const int *literals,
+                            size_t size);
+
+// Negation symmetric variables 'v' (replacing 'v' by '-v' maps the
+// formula to itself) as found by 'one_symmetry' with the same options.  A
+// zero 'options' pointer selects the defaults (all zero).  The result is
+// the list of variables.
+
+typedef struct symmetry_negation_options
+{
+  int clause_swapping; // '--clauseswapping'
+  int sort_clauses;    // '--sortclauses'
+  int sort_literals;   // '--sortliterals'
+  int fixpoint;        // '--fixpoint'
+} symmetry_negation_options;
+
+size_t detect_negation_symmetries(symmetry_context *,
+                                  const symmetry_negation_options *,
+                                  int *variables, size_t capacity);
+
+// Interchangeable variables as found by 'two_symmetry' with the same
+// options.  The result is a list of groups, each terminated by zero, in
+// which every pair of members is a transposition, e.g., '1 2 0 3 -4 0' for
+// '1 <-> 2' and the phase-shifted '3 <-> -4'.  Without 'groups' all groups
+// are pairs.
+
+typedef struct symmetry_transposition_options
+{
+  int sorting; // '--sorting'
+  int groups;  // '--groups'
+  int phase;   // '--phase'
+} symmetry_transposition_options;
+
+size_t detect_transpositions(symmetry_context *,
+                             const symmetry_transposition_options *,
+                             int *groups, size_t capacity);
+
+// Copy the result of the last detection again, for instance after
+// sizing the buffer with a first detection call of capacity zero.
+// Returns the size of the result as the detection did.
+
+size_t symmetry_get_result(const symmetry_context *, int *buffer,
+                           size_t capacity);
+
+// Statistics of the last detection.
+
+typedef struct symmetry_statistics
+{
+  size_t variables, clauses, literals;
+  size_t checked; // Candidates or pairs checked.
+  size_t found;   // Symmetries (transpositions within groups counted).
+  unsigned long long clause_comparisons;
+  unsigned long long literal_comparisons;
+  double seconds; // Thread time of detection.
+} symmetry_statistics;
+
+void symmetry_get_statistics(const symmetry_context *,
+                             symmetry_statistics *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
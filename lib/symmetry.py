@@ -0,0 +1,211 @@
+"""Python bindings of 'libsymmetry.so' (see 'symmetry.h') through ctypes.
+
+Formulas are passed as flat buffers of 32-bit literals in which every
+clause is terminated by zero (a DIMACS file without header), for instance
+an 'array.array('i')', a numpy 'int32' array or 'bytes' of native ints.
+The library borrows the memory of the buffer, which is exported through
+the buffer protocol (also for read-only buffers), thus it is neither
+copied nor converted in Python.  The context holds the export until
+'reset' or its deletion, during which the buffer can not be resized and
+must not be changed.  Every detection copies the clauses once into memory
+of the context, since detection reorders literals.  Results are returned
+as 'array.array('i')' in the same flat format and statistics as
+dictionary, so sweeping many instances needs neither processes nor text
+parsing.
+
+  import array, symmetry
+  context = symmetry.Context()
+  context.add(array.array('i', [1, 2, 0, -1, 2, 0]))
+  context.negation_symmetries()             # array('i', [1])
+  context.transpositions(groups=True)       # groups terminated by zero
+  context.statistics()['clause_comparisons']
+
+The library is loaded from the directory of this module ('make -C lib')
+unless the environment variable 'LIBSYMMETRY' names another path.
+"""
+
+import array
+import ctypes
+import os
+
+_path = os.environ.get('LIBSYMMETRY') or os.path.join(
+    os.path.dirname(os.path.abspath(__file__)), 'libsymmetry.so')
+_lib = ctypes.CDLL(_path)
+
+_ERROR = ctypes.c_size_t(-1).value
+
+
+class _Negation_options(ctypes.Structure):
+  _fields_ = [('clause_swapping', ctypes.c_int),
+              ('sort_clauses', ctypes.c_int),
+              ('sort_literals', ctypes.c_int),
+              ('fixpoint', ctypes.c_int)]
+
+
+class _Transposition_options(ctypes.Structure):
+  _fields_ = [('sorting', ctypes.c_int),
+              ('groups', ctypes.c_int),
+              ('phase', ctypes.c_int)]
+
+
+class _Statistics(ctypes.Structure):
+  _fields_ = [('variables', ctypes.c_size_t),
+              ('clauses', ctypes.c_size_t),
+              ('literals', ctypes.c_size_t),
+              ('checked', ctypes.c_size_t),
+              ('found', ctypes.c_size_t),
+              ('clause_comparisons', ctypes.c_ulonglong),
+              ('literal_comparisons', ctypes.c_ulonglong),
+              ('seconds', ctypes.c_double)]
+
+
+_int_pointer = ctypes.POINTER(ctypes.c_int)
+
+
+# The C 'Py_buffer' filled by 'PyObject_GetBuffer', which unlike ctypes
+# 'from_buffer' also exports read-only buffers.
+
+class _Py_buffer(ctypes.Structure):
+  _fields_ = [('buf', ctypes.c_void_p),
+              ('obj', ctypes.c_void_p),
+              ('len', ctypes.c_ssize_t),
+              ('itemsize', ctypes.c_ssize_t),
+              ('readonly', ctypes.c_int),
+              ('ndim', ctypes.c_int),
+              ('format', ctypes.c_char_p),
+              ('shape', ctypes.POINTER(ctypes.c_ssize_t)),
+              ('strides', ctypes.POINTER(ctypes.c_ssize_t)),
+              ('suboffsets', ctypes.POINTER(ctypes.c_ssize_t)),
+              ('internal', ctypes.c_void_p)]
+
+
+_PyBUF_SIMPLE = 0
+
+ctypes.pythonapi.PyObject_GetBuffer.restype = ctypes.c_int
+ctypes.pythonapi.PyObject_GetBuffer.argtypes = [
+    ctypes.py_object, ctypes.POINTER(_Py_buffer), ctypes.c_int]
+ctypes.pythonapi.PyBuffer_Release.restype = None
+ctypes.pythonapi.PyBuffer_Release.argtypes = [ctypes.POINTER(_Py_buffer)]
+
+_lib.symmetry_new.restype = ctypes.c_void_p
+_lib.symmetry_new.argtypes = []
+_lib.symmetry_delete.argtypes = [ctypes.c_void_p]
+_lib.symmetry_reset.argtypes = [ctypes.c_void_p]
+_lib.symmetry_add_clauses.restype = ctypes.c_size_t
+_lib.symmetry_add_clauses.argtypes = [ctypes.c_void_p, _int_pointer,
+                                      ctypes.c_size_t]
+_lib.detect_negation_symmetries.restype = ctypes.c_size_t
+_lib.detect_negation_symmetries.argtypes = [
+    ctypes.c_void_p, ctypes.POINTER(_Negation_options), _int_pointer,
+    ctypes.c_size_t]
+_lib.detect_transpositions.restype = ctypes.c_size_t
+_lib.detect_transpositions.argtypes = [
+    ctypes.c_void_p, ctypes.POINTER(_Transposition_options), _int_pointer,
+    ctypes.c_size_t]
+_lib.symmetry_get_result.restype = ctypes.c_size_t
+_lib.symmetry_get_result.argtypes = [ctypes.c_void_p, _int_pointer,
+                                     ctypes.c_size_t]
+_lib.symmetry_get_statistics.argtypes = [ctypes.c_void_p,
+                                         ctypes.POINTER(_Statistics)]
+
+
+def _literals(buffer):
+  """Return the exported buffer and its number of literals."""
+  view = memoryview(buffer)
+  if view.ndim > 1 or not view.c_contiguous:
+    raise ValueError('literals need a flat contiguous buffer')
+  if view.format in ('B', 'b', 'c'):  # Raw bytes of native integers.
+    view = view.cast('B').cast('i')
+  if view.itemsize != 4 or view.format.lstrip('@=<') not in ('i', 'l'):
+    raise ValueError(f"literals need 32-bit integers, not '{view.format}'")
+  exported = _Py_buffer()
+  ctypes.pythonapi.PyObject_GetBuffer(view, ctypes.byref(exported),
+                                      _PyBUF_SIMPLE)
+  return exported, view.nbytes // 4
+
+
+class Context:
+  """Clauses of one formula and the detection engines of both tools."""
+
+  def __init__(self, literals=None):
+    self._borrowed = []  # Exported buffers of 'add'.
+    self._context = _lib.symmetry_new()
+    if not self._context:
+      raise MemoryError('could not allocate symmetry context')
+    if literals is not None:
+      self.add(literals)
+
+  def __del__(self):
+    if getattr(self, '_context', None):
+      _lib.symmetry_delete(self._context)
+      self._context = None
+    self._release()
+
+  def _release(self):
+    for exported in getattr(self, '_borrowed', ()):
+      ctypes.pythonapi.PyBuffer_Release(ctypes.byref(exported))
+    self._borrowed = []
+
+  def reset(self):
+    """Remove all clauses (keeping the memory for the next formula) and
+    release the buffers of 'add'."""
+    _lib.symmetry_reset(self._context)
+    self._release()
+
+  def add(self, literals):
+    """Add zero terminated clauses and return their number.  The buffer is
+    borrowed until 'reset' or the deletion of the context."""
+    exported, n = _literals(literals)
+    added = _lib.symmetry_add_clauses(
+        self._context, ctypes.cast(exported.buf, _int_pointer), n)
+    if added == _ERROR:
+      ctypes.pythonapi.PyBuffer_Release(ctypes.byref(exported))
+      raise ValueError('invalid literal or last clause not terminated')
+    self._borrowed.append(exported)
+    return added
+
+  def _result(self, size):
+    # The first detection call only returns the size of the result.
+    if size == _ERROR:
+      raise MemoryError('symmetry detection out of memory')
+    result = array.array('i', bytes(4 * size))
+    if size:
+      data = (ctypes.c_int * size).from_buffer(result)
+      _lib.symmetry_get_result(self._context,
+                               ctypes.cast(data, _int_pointer), size)
+      del data  # Release the export of 'result'.
+    return result
+
+  def negation_symmetries(self, clause_swapping=False, sort_clauses=False,
+                          sort_literals=False, fixpoint=False):
+    """Negation symmetric variables as found by 'one_symmetry'."""
+    options = _Negation_options(clause_swapping, sort_clauses,
+                                sort_literals, fixpoint)
+    return self._result(_lib.detect_negation_symmetries(
+        self._context, ctypes.byref(options), None, 0))
+
+  def transpositions(self, sorting=False, groups=False, phase=False):
+    """Groups of interchangeable literals, each terminated by zero, as
+    found by 'two_symmetry'."""
+    options = _Transposition_options(sorting, groups, phase)
+    return self._result(_lib.detect_transpositions(
+        self._context, ctypes.byref(options), None, 0))
+
+  def statistics(self):
+    """Counters and time of the last detection."""
+    statistics = _Statistics()
+    _lib.symmetry_get_statistics(self._context, ctypes.byref(statistics))
+    return {name: getattr(statistics, name)
+            for name, _ in _Statistics._fields_}
+
+
+def groups(flat):
+  """Split a flat result of 'transpositions' into lists of literals."""
+  result, group = [], []
+  for lit in flat:
+    if lit:
+      group.append(lit)
+    else:
+      result.append(group)
+      group = []
+  return result
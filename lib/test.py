@@ -0,0 +1,35 @@
+import array
+import ctypes
+
+import symmetry
+
+# Literals have to be below 'INT_MAX' in absolute value.  Out of range
+# literals are rejected by both entry points without adding anything, thus
+# the context still detects the symmetries of the valid clauses.
+
+INVALID = [2147483647, -2147483647, -2147483648]
+
+def invalid_literal_test():
+  add_clause = symmetry._lib.symmetry_add_clause
+  add_clause.restype = ctypes.c_int
+  add_clause.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_int),
+                         ctypes.c_size_t]
+  context = symmetry.Context(array.array('i', [1, 2, 0, -1, 2, 0]))
+  rejected = 0
+  for lit in INVALID:
+    try:
+      context.add(array.array('i', [1, lit, 0]))
+    except ValueError:
+      rejected += 1
+    clause = (ctypes.c_int * 2)(1, lit)
+    if add_clause(context._context, clause, 2):
+      rejected += 1
+  found = context.negation_symmetries()
+  if rejected == 2 * len(INVALID) and list(found) == [1]:
+    print(f"Test on invalid literals successful! ({rejected} rejected)")
+  else:
+    print(f"Test on invalid literals failed. ({rejected} rejected, "
+          f"found {list(found)})")
+
+if __name__ == "__main__":
+  invalid_literal_test()
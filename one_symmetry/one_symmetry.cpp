@@ -9,6 +9,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <string>
 #include <vector>
 
 // Linux/Unix system specific.
@@ -16,11 +17,16 @@
 #include <sys/resource.h>
 #include <sys/time.h>
 
-static int verbosity; // -1=quiet, 0=normal, 1=verbose, INT_MAX=logging
-
-static int variables; // Variable range: 1,..,<variables>
+#include "../common/batch.hpp"
+#include "../common/cache.hpp"
+#include "../common/formula.hpp"
+#include "../common/memory.hpp"
+#include "../common/negation.hpp"
+#include "../common/output.hpp"
+#include "../common/profile.hpp"
+#include "../common/stats.hpp"
 
-static size_t added; // Number of added clauses.
+static int verbosity; // -1=quiet, 0=normal, 1=verbose, INT_MAX=logging
 
 static int sort_clauses = false; // sort clauses of canditates in matrix by size
 
@@ -28,85 +34,60 @@ static int sort_literals = false; // sort literals in clauses of candidates
 
 static int clause_swapping = false; // use clause swapping in check_symmetries
 
-struct Clause
-{
-#ifndef NDEBUG
-  size_t id;
-#endif
-  unsigned size;
-  int literals[];
-
-  // The following two functions allow simple ranged-based for-loop
-  // iteration over Clause literals with the following idiom:
-  //
-  //   Clause *c = ...
-  //   for (auto lit : *c)
-  //     do_something_with (lit);
-  //
-  int *begin() { return literals; }
-  int *end() { return literals + size; }
-};
+static int simplify = false; // print the formula without symmetric variables
 
-static std::vector<Clause *> clauses;
-static Clause *empty_clause; // Empty clause found.
+static int fixpoint = false; // eliminate symmetric variables until none is left
 
-std::vector<int> symmetries;
-std::vector<int> candidates;
+static int streaming = false; // print every symmetry as soon as it is found
 
-static std::vector<Clause *> *matrix;
+static int statistics = false; // print phase times and counters at the end
 
-// Get process-time of this process.  This is not portable to Windows but
-// should work on other Unixes such as MacOS as is.
+static const char *stats_json; // append a JSON record of statistics here
 
-static double process_time(void)
-{
-  struct rusage u;
-  double res;
-  if (getrusage(RUSAGE_SELF, &u))
-    return 0;
-  res = u.ru_utime.tv_sec + 1e-6 * u.ru_utime.tv_usec;
-  res += u.ru_stime.tv_sec + 1e-6 * u.ru_stime.tv_usec;
-  return res;
-}
+static bool batch = false; // process many CNFs listed in files or directories
+
+static int threads = 1; // instances processed in parallel in batch mode
+
+static const char *cache_dir; // reuse results of identical runs stored here
+
+// The formula and the search for symmetric variables in it (see
+// 'negation.hpp'), with the options above copied in 'options'.  In batch
+// mode every thread processes one instance after the other and both are
+// only cleared between two instances, so their memory is reused.
+
+static Negation_options options;
+static thread_local Formula formula;
+static thread_local Negation_search search;
 
 static void message(const char *fmt, ...)
 {
   if (verbosity < 0)
     return;
-  fputs("c ", stdout);
+  write_string(stdout_writer, "c ");
   va_list ap;
   va_start(ap, fmt);
-  vprintf(fmt, ap);
+  vwrite_format(stdout_writer, fmt, ap);
   va_end(ap);
-  fputc('\n', stdout);
-  fflush(stdout);
-}
-
-static void line()
-{
-  if (verbosity < 0)
-    return;
-  fputs("c\n", stdout);
-  fflush(stdout);
+  write_char(stdout_writer, '\n');
 }
 
 static void verbose(const char *fmt, ...)
 {
   if (verbosity <= 0)
     return;
-  fputs("c ", stdout);
+  write_string(stdout_writer, "c ");
   va_list ap;
   va_start(ap, fmt);
-  vprintf(fmt, ap);
+  vwrite_format(stdout_writer, fmt, ap);
   va_end(ap);
-  fputc('\n', stdout);
-  fflush(stdout);
+  write_char(stdout_writer, '\n');
 }
 
 // Print error message and 'die'.
 
 static void die(const char *fmt, ...)
 {
+  release_writer(stdout_writer);
   fprintf(stderr, "babysat: error: ");
   va_list ap;
   va_start(ap, fmt);
@@ -116,79 +97,95 @@ static void die(const char *fmt, ...)
   exit(1);
 }
 
-static void initialize(void)
+// Parse integer valued options of the form '<name>=<value>'.
+
+static bool parse_int_option(const char *arg, const char *name, int *res,
+                             int min)
 {
-  assert(variables < INT_MAX);
-  unsigned size = variables + 1;
+  size_t len = strlen(name);
+  if (strncmp(arg, name, len) || arg[len] != '=')
+    return false;
+  const char *p = arg + len + 1;
+  long val = 0;
+  if (!*p)
+    die("missing value in '%s'", arg);
+  for (; *p; p++)
+  {
+    if (*p < '0' || *p > '9' || (val = 10 * val + (*p - '0')) > INT_MAX)
+      die("invalid value in '%s'", arg);
+  }
+  if (val < min)
+    die("value in '%s' below %d", arg, min);
+  *res = val;
+  return true;
+}
 
-  unsigned twice = 2 * size;
+static thread_local const char *file_name;
+static thread_local bool close_file;
+static thread_local FILE *file;
 
-  matrix = new std::vector<Clause *>[twice];
+// Thrown by 'skip_instance' in batch mode to continue with the next one.
 
-  // We subtract 'variables' in order to be able to access
-  // the arrays with a negative index (valid in C/C++).
+struct Skip_instance
+{
+};
 
-  matrix += variables;
-}
+// Errors of a single instance.
 
-static void connect_literal(int lit, Clause *c)
+static void instance_error(const char *fmt, ...)
 {
-  matrix[lit].push_back(c);
+  char buffer[512];
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(buffer, sizeof buffer, fmt, ap);
+  va_end(ap);
+  flush_writer(stdout_writer);
+  flockfile(stderr);
+  fprintf(stderr, "babysat: %s\n", buffer);
+  funlockfile(stderr);
 }
 
-static Clause *add_clause(std::vector<int> &literals)
+static void skip_instance(void)
 {
-  size_t size = literals.size();
-  size_t bytes = sizeof(struct Clause) + size * sizeof(int);
-  Clause *c = (Clause *)new char[bytes];
-
-#ifndef NDEBUG
-  c->id = added;
-#endif
-  added++;
-
-  assert(clauses.size() <= (size_t)INT_MAX);
-  c->size = size;
-
-  int *q = c->literals;
-  for (auto lit : literals)
-    *q++ = lit;
-
-  // debug(c, "new");
-  clauses.push_back(c); // Save it on global stack of clauses.
-
-  // Connect the literals of the clause in the matrix.
-
-  for (auto lit : *c)
-    connect_literal(lit, c);
-
-  // Handle the special case of empty and unit clauses.
-
-  if (!size)
-  {
-    // debug(c, "parsed empty clause");
-    empty_clause = c;
-  }
-  return c;
+  if (batch)
+    throw Skip_instance();
+  exit(1);
 }
 
-static const char *file_name;
-static bool close_file;
-static FILE *file;
-
 static void parse_error(const char *fmt, ...)
 {
-  fprintf(stderr, "babysat: parse error in '%s': ", file_name);
+  char buffer[256];
   va_list ap;
   va_start(ap, fmt);
-  vfprintf(stderr, fmt, ap);
+  vsnprintf(buffer, sizeof buffer, fmt, ap);
   va_end(ap);
-  fputc('\n', stderr);
-  exit(1);
+  instance_error("parse error in '%s': %s", file_name, buffer);
+  skip_instance();
+}
+
+// Projects the memory of the formula from the header and the number of
+// literals, assuming at least one literal in every clause not yet read,
+// occurrence lists with half of their size as slack and the allocation
+// header of every clause in the arena, and stops if the projection exceeds
+// '--memory-limit'.
+
+static void check_memory_limit(size_t clauses, size_t literals)
+{
+  double bytes =
+      2.0 * (formula.variables + 1) * sizeof(std::vector<Clause *>) +
+      (double)clauses * (sizeof(Clause *) + sizeof(Clause)) +
+      (double)literals * (sizeof(int) + 1.5 * sizeof(Clause *));
+  if (!exceeds_memory_limit(bytes))
+    return;
+  instance_error("error: memory of '%s' projected to %.1f MB exceeds "
+                 "limit of %d MB",
+                 file_name, bytes / 1048576.0, memory_limit);
+  skip_instance();
 }
 
 static void parse(void)
 {
+  Phase_scope scope(PARSE);
   int ch;
   while ((ch = getc(file)) == 'c')
   {
@@ -198,12 +195,15 @@ static void parse(void)
   }
   if (ch != 'p')
     parse_error("expected 'c' or 'p'");
-  int clauses;
+  int variables, clauses;
   if (fscanf(file, " cnf %d %d", &variables, &clauses) != 2 || variables < 0 ||
       variables >= INT_MAX || clauses < 0 || clauses >= INT_MAX)
     parse_error("invalid header");
   message("parsed header 'p cnf %d %d'", variables, clauses);
-  initialize();
+  formula.variables = variables;
+  if (memory_limit)
+    check_memory_limit(clauses, clauses);
+  initialize_formula(formula, variables);
   std::vector<int> clause;
 
   int lit = 0, parsed = 0;
@@ -217,13 +217,14 @@ static void parse(void)
     if (lit)
     {
       clause.push_back(lit);
-      literals++;
+      if (!(++literals & 0xfffff) && memory_limit)
+        check_memory_limit(clauses, literals + (clauses - parsed));
     }
     else
     {
       // std::sort(clause.begin(), clause.end(), [](int i, int j)
       //           { return abs(i) < abs(j); });
-      add_clause(clause);
+      add_clause(formula, clause.data(), clause.size());
       clause.clear();
       parsed++;
     }
@@ -235,217 +236,256 @@ static void parse(void)
   if (close_file)
     fclose(file);
   verbose("parsed %zu literals in %d clauses", literals, parsed);
+  flush_writer(stdout_writer);
 }
 
-void sort_candidate_clauses()
+// In streaming mode symmetries are printed and flushed as soon as they are
+// found (even with '-q'), followed by a summary line at the end.
+
+static void stream_symmetry(int var)
 {
-  for (auto can : candidates)
-  {
-    std::sort(matrix[can].begin(), matrix[can].end(), [](Clause *i, Clause *j)
-              { return i->size < j->size; });
-    std::sort(matrix[-can].begin(), matrix[-can].end(), [](Clause *i, Clause *j)
-              { return i->size < j->size; });
-  }
+  write_format(stdout_writer, "c found symmetry on %d\n", var);
+  flush_writer(stdout_writer);
 }
 
-void sort_candidate_literals()
+// Print the formula left after eliminating all symmetric variables, with
+// the remaining variables renumbered consecutively.
+
+static void print_simplified()
 {
-  for (auto can : candidates)
+  const int variables = formula.variables;
+  const auto &clauses = formula.clauses;
+  const auto &symmetries = search.symmetries;
+  std::vector<int> renamed(variables + 1);
+  for (auto var : symmetries)
+    renamed[var] = -1;
+  int remaining = 0;
+  for (int var = 1; var <= variables; var++)
+    if (!renamed[var])
+      renamed[var] = ++remaining;
+
+  size_t remaining_clauses = 0;
+  for (auto c : clauses)
+    if (!c->garbage)
+      remaining_clauses++;
+
+  message("eliminated %zu variables and %zu clauses", symmetries.size(),
+          clauses.size() - remaining_clauses);
+  message("model count multiplier 2^%zu", symmetries.size());
+
+  write_format(stdout_writer, "p cnf %d %zu\n", remaining, remaining_clauses);
+  for (auto c : clauses)
   {
-    for (auto c : matrix[can])
-    {
-      std::sort(c->begin(), c->end(), [](int i, int j)
-                { return abs(i) < abs(j); });
-    }
-    for (auto c : matrix[-can])
-    {
-      std::sort(c->begin(), c->end(), [](int i, int j)
-                { return abs(i) < abs(j); });
-    }
+    if (c->garbage)
+      continue;
+    for (auto lit : *c)
+      write_literal(stdout_writer, lit < 0 ? -renamed[-lit] : renamed[lit]);
+    write_string(stdout_writer, "0\n");
   }
 }
 
-// find candidate variables by checking whether their positive and negative occurences are the same
-void find_symmetries()
+// Find and print the symmetric variables of the parsed formula.
+
+static void analyze(void)
 {
-  for (int i = 1; i <= variables; i++)
-  {
-    if (matrix[i].size() != 0 && matrix[i].size() == matrix[-i].size())
-    {
-      candidates.push_back(i);
-    }
-  }
-  if (sort_clauses)
+  find_candidates(search);
+
+  message("found %d candidates", search.candidates.size());
+
+  if (fixpoint)
   {
-    sort_candidate_clauses();
+    find_symmetries_fixpoint(search);
   }
-  if (sort_literals)
+  else
   {
-    sort_candidate_literals();
+    find_symmetries(search);
   }
-}
 
-bool check_sorted_clause_symmetry(Clause *c1, Clause *c2, int var)
-{
-  if (c1->size != c2->size)
+  if (simplify && !fixpoint)
   {
-    return false;
+    Phase_scope scope(CHECK);
+    for (auto var : search.symmetries)
+    {
+      eliminate_variable(search, var);
+    }
   }
 
-  auto c1_literals = c1->literals;
-  auto c2_literals = c2->literals;
+  if (statistics || stats_json)
+    account_memory(formula), account_memory(search);
 
-  for (int i = 0; i < c1->size; i++)
+  Phase_scope scope(OUTPUT);
+  if (streaming)
   {
-    if (c1_literals[i] == var and c2_literals[i] == -var)
-    {
-      continue;
-    }
-    else if (c1_literals[i] != c2_literals[i])
+    write_format(stdout_writer, "c summary: %zu symmetries\n",
+                 search.symmetries.size());
+  }
+  else
+  {
+    for (auto sym : search.symmetries)
     {
-      return false;
+      message("found symmetry on %d", sym);
     }
   }
-  return true;
+  if (simplify)
+  {
+    print_simplified();
+  }
+  flush_writer(stdout_writer);
 }
 
-// check whether two clauses are identical, except for a given variable
-// which occures positivly in one clause and negativly in the other
-bool check_clause_symmetry(Clause *c1, Clause *c2, int var)
+// Every option which changes the printed result is part of the key of
+// the result cache (see 'cache.hpp').
+
+static std::string cache_options(void)
 {
-  if (sort_literals)
-  {
-    return check_sorted_clause_symmetry(c1, c2, var);
-  }
+  char buffer[128];
+  snprintf(buffer, sizeof buffer, "one_symmetry 1 c%d l%d s%d f%d S%d x%d v%d",
+           sort_clauses, sort_literals, clause_swapping, fixpoint, simplify,
+           streaming, verbosity);
+  return buffer;
+}
 
-  if (c1->size != c2->size)
-  {
-    return false;
-  }
+static Run_info run_info(void)
+{
+  return {"one_symmetry", file_name, formula.variables,
+          formula.clauses.size(), search.checked, search.symmetries.size(),
+          false};
+}
 
-  auto c1_literals = c1->literals;
-  auto c2_literals = c2->literals;
+// On a cache hit 'run' holds the numbers stored with the result and there
+// is no profile, since nothing was checked.
 
-  // go throug all literals of the first clause and check
-  // if they can be matched to a literal in the second clause
-  // or to its negation if the literal is of the given variable
-  for (int i = 0; i < c1->size; i++)
+static bool report_statistics(const Run_info &run)
+{
+  if (statistics)
+    print_statistics(stdout_writer, run);
+  if (profile_top && run.cache_hit)
+    write_string(stdout_writer, "c\nc profile skipped (cache hit)\n");
+  else if (profile_top)
+    print_profile(stdout_writer);
+  if (stats_json && !append_json_statistics(stats_json, run))
   {
-    bool found = false;
-    for (int j = i; j < c2->size; j++)
-    {
-      if (c1_literals[i] == c2_literals[j] ||
-          (c1_literals[i] == var && c2_literals[j] == -var))
-      {
-        // after finding a matching literal, move it back
-        // so only unmatched literals have to be considered
-        found = true;
-        int tmp = c2_literals[i];
-        c2_literals[i] = c2_literals[j];
-        c2_literals[j] = tmp;
-        break;
-      }
-    }
-    if (!found)
-    {
-      return false;
-    }
+    instance_error("error: could not append statistics to '%s'", stats_json);
+    return false;
   }
   return true;
 }
 
-bool check_symmetry_swap(int var)
+// Clear the state of the last instance but keep its memory.
+
+static void reset(void)
 {
-  auto &pos_occs = matrix[var];
-  auto &neg_occs = matrix[-var];
-  // go through all clauses with a positive occurence of the given variable
-  // and check if there exists an otherwise identical clause with a negative occurence
-  for (int i = 0; i < pos_occs.size(); i++)
-  {
-    bool found = false;
-    for (int j = i; j < neg_occs.size(); j++)
-    {
-      if (check_clause_symmetry(pos_occs[i], neg_occs[j], var))
-      {
-        found = true;
-        // after finding a matching clause, move it back
-        // so only unmatched clauses have to be considered
-        Clause *tmp = neg_occs[i];
-        neg_occs[i] = neg_occs[j];
-        neg_occs[j] = tmp;
-        break;
-      }
-    }
-    if (!found)
-    {
-      return false;
-    }
-  }
-  return true;
+  reset_formula(formula);
+  reset_search(search);
+  stats = Statistics();
+  memory = Memory_usage();
+  profile.clear();
 }
 
-// check for a syntactic symmetry of a given variable with its negation
-bool check_symmetry(int var)
+static void release(void)
 {
-  auto &pos_occs = matrix[var];
-  auto &neg_occs = matrix[-var];
-  // go through all clauses with a positive occurence of the given variable
-  // and check if there exists an otherwise identical clause with a negative occurence
-  for (auto c1 : pos_occs)
-  {
-    bool found = false;
-    for (auto c2 : neg_occs)
-    {
-      if (check_clause_symmetry(c1, c2, var))
-      {
-        found = true;
-        break;
-      }
-    }
-    if (!found)
-    {
-      return false;
-    }
-  }
-  return true;
+  release_formula(formula);
+  close_perf_counters();
+  delete_writer(stdout_writer);
 }
 
-void find_symmetries()
+// Process the instance read from 'file' and reset the state afterwards.
+
+static bool process_file_untraced(void)
 {
-  for (auto var : candidates)
+  search.formula = &formula;
+  search.options = &options;
+  message("reading from '%s'", file_name);
+  std::string key, result;
+  if (cache_dir)
+    key = cache_key(file, cache_options());
+  Run_info cached = run_info();
+  FILE *entry = key.empty() ? 0 : lookup_cache(cache_dir, key, cached);
+  if (entry)
   {
-    if (clause_swapping)
-    {
-      if (check_symmetry_swap(var))
-      {
-        symmetries.push_back(var);
-      }
-    }
-    else
-    {
-      if (check_symmetry(var) && check_symmetry(-var))
-      {
-        symmetries.push_back(var);
-      }
-    }
+    copy_cache(entry, stdout_writer);
+    if (close_file)
+      fclose(file);
+    bool ok = report_statistics(cached);
+    flush_writer(stdout_writer);
+    release_writer(stdout_writer);
+    reset();
+    return ok;
+  }
+  if (!key.empty())
+  {
+    flush_writer(stdout_writer);
+    stdout_writer.copy = &result;
+  }
+  bool ok = true;
+  try
+  {
+    parse();
+    build_index(formula);
+    if (statistics || stats_json)
+      account_memory(formula);
+    analyze();
   }
+  catch (Skip_instance &)
+  {
+    if (close_file)
+      fclose(file);
+    ok = false;
+  }
+  stdout_writer.copy = 0;
+  if (ok && !key.empty())
+    store_cache(cache_dir, key, run_info(), result);
+  if (ok)
+    ok = report_statistics(run_info());
+  flush_writer(stdout_writer);
+  release_writer(stdout_writer);
+  reset();
+  return ok;
 }
 
-static void delete_clause(Clause *c)
+static bool process_file(void)
 {
-  delete[] c;
+  double start = trace_path ? trace_clock() : 0;
+  bool ok = process_file_untraced();
+  if (trace_path)
+    add_trace_event(file_name, "instance", start, trace_clock() - start);
+  return ok;
 }
 
-static void release(void)
+static bool process_instance(const char *path)
 {
-  for (auto c : clauses)
-    delete_clause(c);
-  matrix -= variables;
-  delete[] matrix;
+  file_name = path;
+  if (!(file = fopen(file_name, "r")))
+  {
+    instance_error("error: could not open and read '%s'", path);
+    release_writer(stdout_writer);
+    return false;
+  }
+  close_file = true;
+  return process_file();
+}
+
+static Batch batch_instances; // See 'batch.hpp'.
+
+static int run_batch(void)
+{
+  double start = wall_clock_time();
+  size_t workers = run_batch_workers(batch_instances, threads,
+                                     process_instance, release, 0);
+  size_t failed = batch_instances.failed;
+  message("batch of %zu instances (%zu failed) on %zu threads",
+          batch_instances.files.size(), failed, workers);
+  message("%.2f seconds wall-clock time, %.2f seconds process time",
+          wall_clock_time() - start, process_time());
+  if (trace_path && !write_trace())
+    die("could not write trace '%s'", trace_path);
+  flush_writer(stdout_writer);
+  return failed ? 1 : 0;
 }
 
 int main(int argc, char **argv)
 {
+  std::vector<const char *> paths;
   for (int i = 1; i != argc; i++)
   {
     const char *arg = argv[i];
@@ -469,39 +509,89 @@ int main(int argc, char **argv)
       sort_literals = true;
     else if (!strcmp(arg, "-s") || !strcmp(arg, "--clauseswapping"))
       clause_swapping = true;
+    else if (!strcmp(arg, "--simplify"))
+      simplify = true;
+    else if (!strcmp(arg, "--fixpoint"))
+      fixpoint = true;
+    else if (!strcmp(arg, "--stream"))
+      streaming = true;
+    else if (!strcmp(arg, "--stats"))
+      statistics = true;
+    else if (!strcmp(arg, "--perf"))
+      statistics = perf_counting = true;
+    else if (parse_int_option(arg, "--profile", &profile_top, 1))
+      continue;
+    else if (parse_int_option(arg, "--memory-limit", &memory_limit, 0))
+      continue;
+    else if (!strcmp(arg, "--trace"))
+    {
+      if (++i == argc)
+        die("argument to '--trace' missing (try '-h')");
+      trace_path = argv[i];
+    }
+    else if (parse_int_option(arg, "--trace-threshold", &trace_threshold, 0))
+      continue;
+    else if (!strcmp(arg, "--cache"))
+    {
+      if (++i == argc)
+        die("argument to '--cache' missing (try '-h')");
+      cache_dir = argv[i];
+    }
+    else if (!strcmp(arg, "--stats-json"))
+    {
+      if (++i == argc)
+        die("argument to '--stats-json' missing (try '-h')");
+      stats_json = argv[i];
+    }
+    else if (!strcmp(arg, "--batch"))
+      batch = true;
+    else if (parse_int_option(arg, "--threads", &threads, 1))
+      batch = true;
     else if (arg[0] == '-')
       die("invalid option '%s' (try '-h')", arg);
-    else if (file_name)
-      die("too many arguments '%s' and '%s' (try '-h')", file_name, arg);
     else
-      file_name = arg;
+      paths.push_back(arg);
+  }
+
+  options.sort_clauses = sort_clauses;
+  options.sort_literals = sort_literals;
+  options.clause_swapping = clause_swapping;
+  options.fixpoint = fixpoint;
+  if (streaming)
+    options.found = stream_symmetry;
+
+  if (cache_dir && mkdir(cache_dir, 0777) && errno != EEXIST)
+    die("could not create cache directory '%s'", cache_dir);
+
+  if (batch)
+  {
+    if (streaming) // Would keep the shared output locked per instance.
+      die("'--stream' can not be combined with '--batch'");
+    if (paths.empty())
+      paths.push_back("-");
+    for (auto path : paths)
+      if (const char *failed = collect_batch_files(batch_instances, path))
+        die("could not %s '%s'", failed, path);
+    return run_batch();
   }
 
-  if (!file_name)
+  if (paths.size() > 1)
+    die("too many arguments '%s' and '%s' (try '-h')", paths[0], paths[1]);
+
+  if (paths.empty())
   {
     file_name = "<stdin>";
     assert(!close_file);
     file = stdin;
   }
-  else if (!(file = fopen(file_name, "r")))
+  else if (!(file = fopen(file_name = paths[0], "r")))
     die("could not open and read '%s'", file_name);
   else
     close_file = true;
 
-  message("reading from '%s'", file_name);
-
-  parse();
-
-  find_symmetries();
-
-  message("found %d candidates", candidates.size());
-
-  find_symmetries();
-
-  for (auto sym : symmetries)
-  {
-    message("found symmetry on %d", sym);
-  }
-
+  bool ok = process_file();
   release();
+  if (trace_path && !write_trace())
+    die("could not write trace '%s'", trace_path);
+  return ok ? 0 : 1;
 }
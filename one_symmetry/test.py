@@ -2,6 +2,28 @@ import os
 import subprocess
 import sys
 
+# Batch mode with several threads prints every instance in one piece, in
+# any order, thus the output split at 'reading from' lines has to match the
+# logs of the single runs.
+def batch_test(program, cnfs):
+  res = subprocess.check_output([f'./{program}', '--threads=3', './test_cnfs'])
+  lines = res.decode('ascii').splitlines(keepends=True)
+  outputs = []
+  for line in lines:
+    if line.startswith('c batch of'):  # Summary after all instances.
+      break
+    if line.startswith('c reading from'):
+      outputs.append('')
+    outputs[-1] += line
+  logs = []
+  for cnf in cnfs:
+    with open(f"./test_cnfs/{cnf[:-4]}.log", 'r') as log:
+      logs.append(log.read())
+  if sorted(outputs) == sorted(logs):
+    print(f"Test on batch mode successful! ({len(logs)} instances)")
+  else:
+    print("Test on batch mode failed.")
+
 if __name__ == "__main__":
   cnfs = os.listdir('./test_cnfs')
 
@@ -14,3 +36,5 @@ if __name__ == "__main__":
         print(f"Test on {cnf} successful!")
       else:
         print(f"Test on {cnf} failed.")
+
+  batch_test(sys.argv[1], [cnf for cnf in cnfs if cnf[-4:] == ".cnf"])
@@ -0,0 +1,107 @@
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, '../bench')
+import generate
+
+# Every '<name>.log' is the expected output on '<name>.cnf' and every
+# '<name>-<flags>.log' the expected output with the single letter options
+# '<flags>', e.g. 'pigeonhole-rb.log' with '-r -b'.  Further options on the
+# command line are passed to every run.
+
+
+def groups_found(program, *options):
+  res = subprocess.check_output([f'./{program}', '-g', *options])
+  for line in res.decode('ascii').splitlines():
+    if line.startswith('c groups found: '):
+      return int(line[16:])
+  return 0
+
+
+# A pair budget of a tenth of the sorted exhaustive search on a random
+# formula with planted groups has to find a quarter of the groups, since
+# the budget is spent on the small buckets holding them first.
+
+def budget_test(program, options):
+  with tempfile.NamedTemporaryFile('w', suffix='.cnf') as cnf:
+    generate.generate('ksat', 50000, cnf)
+    cnf.flush()
+    total = groups_found(program, *options, '-s', cnf.name)
+    found = groups_found(program, *options, '--pair-budget=2000', cnf.name)
+    if total and 4 * found >= total:
+      print(f"Test on pair budget successful! ({found} of {total} groups)")
+    else:
+      print(f"Test on pair budget failed. ({found} of {total} groups)")
+
+# A second run on the same input is answered from the cache with the same
+# output (also with '-v'), and its statistics record is marked as cache hit
+# but still has the numbers of the run which stored the result.
+
+def cache_test(program, options):
+  def run(cache, *extra):
+    res = subprocess.check_output([f'./{program}', *options, *extra, '-g',
+                                   '--cache', cache, '--stats-json', '-',
+                                   './test_cnfs/pigeonhole.cnf'])
+    lines = res.decode('ascii').splitlines()
+    return lines[:-1], json.loads(lines[-1])
+  with tempfile.TemporaryDirectory() as cache:
+    output, stored = run(cache)
+    cached_output, cached = run(cache)
+  with tempfile.TemporaryDirectory() as cache:
+    verbose_output, _ = run(cache, '-v')
+    cached_verbose_output, _ = run(cache, '-v')
+  keys = ['variables', 'clauses', 'checked', 'found']
+  if not stored['cache_hit'] and cached['cache_hit'] and \
+     output == cached_output and \
+     verbose_output == cached_verbose_output and \
+     all(stored[key] == cached[key] for key in keys):
+    print("Test on cache hit successful!")
+  else:
+    print("Test on cache hit failed.")
+
+# Batch mode with several threads prints every instance in one piece, in
+# any order, thus the output split at 'reading from' lines has to match the
+# logs of the single runs without further options.
+
+def batch_test(program, options):
+  res = subprocess.check_output([f'./{program}', *options, '--threads=3',
+                                 './test_cnfs'])
+  outputs = []
+  for line in res.decode('ascii').splitlines(keepends=True):
+    if line.startswith('c batch of'):  # Summary after all instances.
+      break
+    if line.startswith('c reading from'):
+      outputs.append('')
+    outputs[-1] += line
+  logs = []
+  for cnf in sorted(os.listdir('./test_cnfs')):
+    if cnf[-4:] == ".cnf":
+      with open(f"./test_cnfs/{cnf[:-4]}.log", 'r') as log:
+        logs.append(log.read())
+  if sorted(outputs) == sorted(logs):
+    print(f"Test on batch mode successful! ({len(logs)} instances)")
+  else:
+    print("Test on batch mode failed.")
+
+if __name__ == "__main__":
+  logs = sorted(os.listdir('./test_cnfs'))
+
+  for log in logs:
+    if (log[-4:] != ".log"):
+      continue
+    name, _, flags = log[:-4].partition('-')
+    options = [f'-{flag}' for flag in flags]
+    res = subprocess.check_output([f'./{sys.argv[1]}', *sys.argv[2:],
+                                   *options, f'./test_cnfs/{name}.cnf'])
+    with open(f"./test_cnfs/{log}", 'r') as expected:
+      if res.decode('ascii') == expected.read():
+        print(f"Test on {log} successful!")
+      else:
+        print(f"Test on {log} failed.")
+
+  budget_test(sys.argv[1], sys.argv[2:])
+  cache_test(sys.argv[1], sys.argv[2:])
+  batch_test(sys.argv[1], sys.argv[2:])
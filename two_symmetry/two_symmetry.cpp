@@ -3,18 +3,42 @@
 // clang-format on
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <climits>
+#include <condition_variable>
+#include <csignal>
 #include <cstdarg>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
 
 // Linux/Unix system specific.
 
+#include <fcntl.h>
 #include <sys/resource.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/un.h>
+
+#include "../common/automorphism.hpp"
+#include "../common/batch.hpp"
+#include "../common/cache.hpp"
+#include "../common/formula.hpp"
+#include "../common/memory.hpp"
+#include "../common/output.hpp"
+#include "../common/profile.hpp"
+#include "../common/stats.hpp"
+#include "../common/transposition.hpp"
+#include <unistd.h>
 
 bool variable_sorting = false;
 
@@ -22,92 +46,96 @@ bool groups = false;
 
 bool breaking_clauses = false;
 
+bool phase = false; // also check phase-shifted transpositions 'a <-> -b'
+
+bool rows = false; // detect interchangeable rows of variables
+
+bool automorphisms = false; // search general literal permutations
+
+static int aut_node_limit = 1000000; // zero means unlimited
+
+static int aut_time_limit = 0; // seconds, zero means unlimited
+
+bool lsh = false; // propose candidate pairs by MinHash instead of all pairs
+
+static int lsh_bands = 1; // more bands: only more false candidates
+
+static int lsh_rows = 4; // more rows per band: fewer false candidates
+
+static int time_limit = 0; // seconds per instance, zero means unlimited
+
+static int pair_budget = 0; // considered pairs, zero means unlimited
+
+bool fingerprinting = false; // only print the fingerprint of the formula
+
+bool streaming = false; // write every symmetry as soon as it is found
+
+bool batch = false; // process many CNFs listed in files or directories
+
+static int threads = 1; // instances processed in parallel in batch mode
+
+static const char *daemon_path; // serve requests on this Unix socket
+
+static const char *cache_dir; // reuse results of identical runs stored here
+
+bool statistics = false; // print phase times and counters after each run
+
+static const char *stats_json; // append a JSON record of statistics here
+
 static int verbosity; // -1=quiet, 0=normal, 1=verbose, INT_MAX=logging
 
-static int variables; // Variable range: 1,..,<variables>
+static int lex_prefix; // Maximum positions of lex-leader constraints.
 
-static size_t added; // Number of added clauses.
+// The formula and the search (see 'transposition.hpp') are thread local.
+// In batch mode every thread processes one instance after the other and
+// both are only cleared between two instances, so the memory of the
+// occurrence lists, the clause arena and the result vectors is reused.
 
-struct Clause
-{
-#ifndef NDEBUG
-  size_t id;
-#endif
-  unsigned size;
-  int literals[];
-
-  // The following two functions allow simple ranged-based for-loop
-  // iteration over Clause literals with the following idiom:
-  //
-  //   Clause *c = ...
-  //   for (auto lit : *c)
-  //     do_something_with (lit);
-  //
-  int *begin() { return literals; }
-  int *end() { return literals + size; }
-};
+static Transposition_options options; // Set from the options above.
+static thread_local Formula formula;
+static thread_local Transposition_search search;
 
-static std::vector<Clause *> clauses;
-static Clause *empty_clause; // Empty clause found.
+static thread_local int aux_variables; // Auxiliary variables of breaking.
 
-std::vector<std::vector<int>> symmetries;
-std::vector<std::vector<int>> symmetry_groups;
-int *sorted_variables;
+// The search stops early on 'SIGINT' (or after the time limit or the pair
+// budget) and the output is then marked as incomplete.
 
-static std::vector<Clause *> *matrix;
+static volatile sig_atomic_t interrupted;
 
-// Get process-time of this process.  This is not portable to Windows but
-// should work on other Unixes such as MacOS as is.
+// In streaming mode results are written as soon as the search finds them
+// (see 'stream_symmetry').
 
-static double process_time(void)
-{
-  struct rusage u;
-  double res;
-  if (getrusage(RUSAGE_SELF, &u))
-    return 0;
-  res = u.ru_utime.tv_sec + 1e-6 * u.ru_utime.tv_usec;
-  res += u.ru_stime.tv_sec + 1e-6 * u.ru_stime.tv_usec;
-  return res;
-}
+static thread_local size_t streamed_clauses; // Breaking clauses written.
 
 static void message(const char *fmt, ...)
 {
   if (verbosity < 0)
     return;
-  fputs("c ", stdout);
+  write_string(stdout_writer, "c ");
   va_list ap;
   va_start(ap, fmt);
-  vprintf(fmt, ap);
+  vwrite_format(stdout_writer, fmt, ap);
   va_end(ap);
-  fputc('\n', stdout);
-  fflush(stdout);
-}
-
-static void line()
-{
-  if (verbosity < 0)
-    return;
-  fputs("c\n", stdout);
-  fflush(stdout);
+  write_char(stdout_writer, '\n');
 }
 
 static void verbose(const char *fmt, ...)
 {
   if (verbosity <= 0)
     return;
-  fputs("c ", stdout);
+  write_string(stdout_writer, "c ");
   va_list ap;
   va_start(ap, fmt);
-  vprintf(fmt, ap);
+  vwrite_format(stdout_writer, fmt, ap);
   va_end(ap);
-  fputc('\n', stdout);
-  fflush(stdout);
+  write_char(stdout_writer, '\n');
 }
 
 // Print error message and 'die'.
 
 static void die(const char *fmt, ...)
 {
+  release_writer(stdout_writer);
   fprintf(stderr, "babysat: error: ");
   va_list ap;
   va_start(ap, fmt);
@@ -117,85 +145,98 @@ static void die(const char *fmt, ...)
   exit(1);
 }
 
-static void initialize(void)
-{
-  assert(variables < INT_MAX);
-  unsigned size = variables + 1;
+// Parse integer valued options of the form '<name>=<value>'.
 
-  unsigned twice = 2 * size;
-
-  matrix = new std::vector<Clause *>[twice];
-
-  // We subtract 'variables' in order to be able to access
-  // the arrays with a negative index (valid in C/C++).
-
-  matrix += variables;
-
-  sorted_variables = new int[variables];
-  for (int i = 1; i <= variables; i++)
+static bool parse_int_option(const char *arg, const char *name, int *res,
+                             int min)
+{
+  size_t len = strlen(name);
+  if (strncmp(arg, name, len) || arg[len] != '=')
+    return false;
+  const char *p = arg + len + 1;
+  long val = 0;
+  if (!*p)
+    die("missing value in '%s'", arg);
+  for (; *p; p++)
   {
-    sorted_variables[i - 1] = i;
+    if (*p < '0' || *p > '9' || (val = 10 * val + (*p - '0')) > INT_MAX)
+      die("invalid value in '%s'", arg);
   }
+  if (val < min)
+    die("value in '%s' below %d", arg, min);
+  *res = val;
+  return true;
 }
 
-static void connect_literal(int lit, Clause *c)
-{
-  matrix[lit].push_back(c);
-}
-
-static Clause *add_clause(std::vector<int> &literals)
-{
-  size_t size = literals.size();
-  size_t bytes = sizeof(struct Clause) + size * sizeof(int);
-  Clause *c = (Clause *)new char[bytes];
-
-#ifndef NDEBUG
-  c->id = added;
-#endif
-  added++;
-
-  assert(clauses.size() <= (size_t)INT_MAX);
-  c->size = size;
+static thread_local const char *file_name;
+static thread_local bool close_file;
+static thread_local FILE *file;
+static thread_local long header_end; // Input offset after the header line.
 
-  int *q = c->literals;
-  for (auto lit : literals)
-    *q++ = lit;
+static const char *output_name; // Augmented formula written with '-o'.
 
-  // debug(c, "new");
-  clauses.push_back(c); // Save it on global stack of clauses.
+// Thrown by 'parse_error' in batch mode to skip the broken instance.
 
-  // Connect the literals of the clause in the matrix.
-
-  for (auto lit : *c)
-    connect_literal(lit, c);
+struct Skip_instance
+{
+};
 
-  // Handle the special case of empty and unit clauses.
+// Errors of a single instance.  The daemon also sends them to its client.
 
-  if (!size)
-  {
-    // debug(c, "parsed empty clause");
-    empty_clause = c;
-  }
-  return c;
+static void instance_error(const char *fmt, ...)
+{
+  char buffer[512];
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(buffer, sizeof buffer, fmt, ap);
+  va_end(ap);
+  if (daemon_path)
+    write_format(stdout_writer, "c %s\n", buffer);
+  flush_writer(stdout_writer);
+  flockfile(stderr);
+  fprintf(stderr, "babysat: %s\n", buffer);
+  funlockfile(stderr);
 }
 
-static const char *file_name;
-static bool close_file;
-static FILE *file;
-
 static void parse_error(const char *fmt, ...)
 {
-  fprintf(stderr, "babysat: parse error in '%s': ", file_name);
+  char buffer[256];
   va_list ap;
   va_start(ap, fmt);
-  vfprintf(stderr, fmt, ap);
+  vsnprintf(buffer, sizeof buffer, fmt, ap);
   va_end(ap);
-  fputc('\n', stderr);
+  instance_error("parse error in '%s': %s", file_name, buffer);
+  if (batch)
+    throw Skip_instance();
+  exit(1);
+}
+
+// Projects the memory of the instance from the header and the number of
+// literals, assuming at least one literal in every clause not yet read
+// and occurrence lists with half of their size as slack, and aborts the
+// instance if the projection exceeds '--memory-limit'.
+
+static void check_memory_limit(size_t clauses, size_t literals)
+{
+  const int variables = formula.variables;
+  double bytes = 2.0 * (variables + 1) * sizeof(std::vector<Clause *>) +
+                 (double)variables * sizeof(int) +
+                 (double)clauses * (sizeof(Clause *) + sizeof(Clause)) +
+                 (double)literals * (sizeof(int) + 1.5 * sizeof(Clause *));
+  if (rows || automorphisms || breaking_clauses)
+    bytes += (2.0 * variables + 1) * sizeof(int) + variables + 1;
+  if (!exceeds_memory_limit(bytes))
+    return;
+  instance_error("memory of '%s' projected to %.1f MB exceeds limit of %d MB",
+                 file_name, bytes / 1048576.0, memory_limit);
+  if (batch)
+    throw Skip_instance();
   exit(1);
 }
 
 static void parse(void)
 {
+  Phase_scope scope(PARSE);
   int ch;
   while ((ch = getc(file)) == 'c')
   {
@@ -206,11 +247,22 @@ static void parse(void)
   if (ch != 'p')
     parse_error("expected 'c' or 'p'");
   int clauses;
+  int variables;
   if (fscanf(file, " cnf %d %d", &variables, &clauses) != 2 || variables < 0 ||
       variables >= INT_MAX || clauses < 0 || clauses >= INT_MAX)
     parse_error("invalid header");
+  while ((ch = getc(file)) != '\n' && ch != EOF)
+    if (ch != ' ' && ch != '\t' && ch != '\r')
+    {
+      ungetc(ch, file);
+      break;
+    }
+  header_end = ftell(file);
   message("parsed header 'p cnf %d %d'", variables, clauses);
-  initialize();
+  formula.variables = variables;
+  if (memory_limit)
+    check_memory_limit(clauses, clauses);
+  initialize_formula(formula, variables);
   std::vector<int> clause;
 
   int lit = 0, parsed = 0;
@@ -224,11 +276,12 @@ static void parse(void)
     if (lit)
     {
       clause.push_back(lit);
-      literals++;
+      if (!(++literals & 0xfffff) && memory_limit)
+        check_memory_limit(clauses, literals + (clauses - parsed));
     }
     else
     {
-      add_clause(clause);
+      add_clause(formula, clause.data(), clause.size());
       clause.clear();
       parsed++;
     }
@@ -240,135 +293,781 @@ static void parse(void)
   if (close_file)
     fclose(file);
   verbose("parsed %zu literals in %d clauses", literals, parsed);
+  flush_writer(stdout_writer);
 }
 
-bool check_clause_symmetry(Clause *c1, Clause *c2, int var1, int var2)
+// Print a generator in cycle notation.  A cycle which reaches the negation
+// of its first literal is closed only after the negated half.
+
+static void print_generator(const std::vector<int> &generator)
 {
-  if (c1->size != c2->size)
+  const int *permutation = search.permutation;
+  auto &seen = search.seen;
+  set_permutation(search, generator);
+  for (size_t i = 0; i < generator.size(); i += 2)
   {
-    return false;
+    int var = generator[i];
+    if (seen[var] || permutation[var] == var)
+      continue;
+    write_char(stdout_writer, '(');
+    int lit = var;
+    do
+    {
+      if (lit != var)
+        write_char(stdout_writer, ' ');
+      write_int(stdout_writer, lit);
+      seen[abs(lit)] = true;
+      lit = permutation[lit];
+    } while (lit != var);
+    write_string(stdout_writer, ") ");
   }
+  for (size_t i = 0; i < generator.size(); i += 2)
+    seen[generator[i]] = false;
+  reset_permutation(search, generator);
+}
 
-  auto c1_literals = c1->literals;
-  auto c2_literals = c2->literals;
+// Lex-leader constraint 'x <= p(x)' over the moved variables in
+// increasing order, where auxiliary variable 'e_k' is implied when the
+// first 'k' positions are equal:
+//
+//   -e_{k-1} -x_k p(x_k)   -e_{k-1} -x_k e_k   -e_{k-1} p(x_k) e_k
+//
+// The largest variable of a cycle without negation is equal to its image
+// as soon as all other positions of the cycle are, and is skipped.  After
+// a variable mapped to its negation no position can be equal anymore.  At
+// most 'lex_prefix' positions are encoded (zero means all).  The result is
+// a flat list of pairs 'x_k, p(x_k)'.
 
-  for (int i = 0; i < c1->size; i++)
+static std::vector<int> lex_leader_positions(const std::vector<int> &generator)
+{
+  const int *permutation = search.permutation;
+  auto &seen = search.seen;
+  set_permutation(search, generator);
+  std::vector<int> support;
+  for (size_t i = 0; i < generator.size(); i += 2)
   {
-    bool found = false;
-    for (int j = i; j < c2->size; j++)
+    int var = generator[i];
+    if (seen[var] || permutation[var] == var)
+      continue;
+    int largest = var, lit = var;
+    do
     {
-      if (c1_literals[i] == c2_literals[j] ||
-          (c1_literals[i] == var1 && c2_literals[j] == var2) ||
-          (c1_literals[i] == -var2 && c2_literals[j] == -var1))
-      {
-        // after finding a matching literal, move it back
-        // so only unmatched literals have to be considered
-        found = true;
-        int tmp = c2_literals[i];
-        c2_literals[i] = c2_literals[j];
-        c2_literals[j] = tmp;
-        break;
-      }
+      support.push_back(abs(lit));
+      seen[abs(lit)] = true;
+      largest = std::max(largest, abs(lit));
+      lit = permutation[lit];
+    } while (abs(lit) != var);
+    if (lit == var)
+      seen[largest] = 2;
+  }
+  std::sort(support.begin(), support.end());
+  support.erase(std::unique(support.begin(), support.end()), support.end());
+
+  std::vector<int> positions;
+  for (auto var : support)
+  {
+    bool full = lex_prefix && positions.size() == 2 * (size_t)lex_prefix;
+    bool unequal = !positions.empty() && positions.back() == -positions.end()[-2];
+    if (seen[var] != 2 && !full && !unequal)
+    {
+      positions.push_back(var);
+      positions.push_back(permutation[var]);
     }
-    if (!found)
+    seen[var] = false;
+  }
+  reset_permutation(search, generator);
+  return positions;
+}
+
+// Positions 'k' give '3k - 2' clauses and 'k - 1' auxiliary variables.
+
+static void print_lex_leader(Writer &out, const std::vector<int> &positions)
+{
+  int equal = 0;
+  for (size_t k = 0; k < positions.size(); k += 2)
+  {
+    int var = positions[k], image = positions[k + 1];
+    if (equal)
+      write_literal(out, -equal);
+    write_literal(out, -var);
+    write_literal(out, image);
+    write_string(out, "0 \n");
+    if (k + 2 == positions.size())
+      break;
+    int next = formula.variables + ++aux_variables;
+    for (int lit : {-var, image})
     {
-      return false;
+      if (equal)
+        write_literal(out, -equal);
+      write_literal(out, lit);
+      write_literal(out, next);
+      write_string(out, "0 \n");
     }
+    equal = next;
+  }
+}
+
+// Copy the clauses of the input file after its header unchanged to 'out'.
+// The kernel copies the bytes directly with 'copy_file_range' (falling
+// back to 'sendfile' and plain reads and writes), so augmenting a huge
+// formula costs about as much as 'cp'.  Returns false if the input is not
+// a regular file (e.g. read from '<stdin>').
+
+static bool copy_input_clauses(Writer &out)
+{
+  if (!close_file || header_end < 0)
+    return false;
+  int in = open(file_name, O_RDONLY);
+  if (in < 0)
+    return false;
+  struct stat st;
+  if (fstat(in, &st) || !S_ISREG(st.st_mode))
+  {
+    close(in);
+    return false;
+  }
+  flush_writer(out);
+
+  int fd = out.fd;
+  off_t offset = header_end;
+  size_t left = st.st_size > offset ? st.st_size - offset : 0;
+  while (left)
+  {
+    ssize_t copied = copy_file_range(in, &offset, fd, 0, left, 0);
+    if (copied <= 0)
+      break;
+    left -= copied;
+  }
+  while (left)
+  {
+    ssize_t copied = sendfile(fd, in, &offset, left);
+    if (copied <= 0)
+      break;
+    left -= copied;
+  }
+  char buffer[1 << 16];
+  while (left)
+  {
+    ssize_t bytes = pread(in, buffer, std::min(left, sizeof buffer), offset);
+    if (bytes <= 0 || write(fd, buffer, bytes) != bytes)
+      die("could not copy '%s' to '%s'", file_name, output_name);
+    offset += bytes;
+    left -= bytes;
   }
+  char last = '\n';
+  if (st.st_size > header_end && pread(in, &last, 1, st.st_size - 1) != 1)
+    die("could not read '%s'", file_name);
+  close(in);
+  if (last != '\n')
+    write_char(out, '\n');
   return true;
 }
 
-bool check_symmetry(int var1, int var2)
+// All symmetries found are turned into generators, transpositions of
+// neighbors in a group being enough to generate it.  Counting positions
+// first gives the header, then the clauses are printed in one go, in the
+// augmented case after the original clauses.
+
+static void print_breaking_clauses(Writer &out, bool augmented)
 {
-  auto &var1_occs = matrix[var1];
-  auto &var2_occs = matrix[var2];
-  for (int i = 0; i < var1_occs.size(); i++)
+  std::vector<std::vector<int>> all;
+  for (auto &sym : search.symmetries)
   {
-    bool found = false;
-    for (int j = i; j < var2_occs.size(); j++)
+    for (size_t i = 0; i + 1 < sym.size(); i++)
+      all.push_back(lex_leader_positions(row_swap({sym[i]}, {sym[i + 1]})));
+  }
+  for (auto &generator : search.generators)
+    all.push_back(lex_leader_positions(generator));
+  for (auto &generator : search.aut_generators)
+    all.push_back(lex_leader_positions(generator));
+
+  size_t aux = 0, breaking = 0;
+  for (auto &positions : all)
+  {
+    size_t k = positions.size() / 2;
+    if (!k)
+      continue;
+    aux += k - 1;
+    breaking += 3 * k - 2;
+  }
+  if (formula.variables + aux > INT_MAX)
+    die("too many auxiliary variables");
+  if (augmented)
+    breaking += formula.clauses.size();
+  write_format(out, "p cnf %zu %zu\n", formula.variables + aux, breaking);
+  if (augmented && !copy_input_clauses(out))
+  {
+    for (auto c : formula.clauses)
     {
-      if (check_clause_symmetry(var1_occs[i], var2_occs[j], var1, var2))
-      {
-        found = true;
-        // after finding a matching clause, move it back
-        // so only unmatched clauses have to be considered
-        Clause *tmp = var2_occs[i];
-        var2_occs[i] = var2_occs[j];
-        var2_occs[j] = tmp;
-        break;
-      }
+      for (auto lit : *c)
+        write_literal(out, lit);
+      write_string(out, "0\n");
+    }
+  }
+  for (auto &positions : all)
+    print_lex_leader(out, positions);
+}
+
+// Output lines of a transposition or group and of a generator.
+
+static void print_symmetry(const std::vector<int> &sym)
+{
+  write_string(stdout_writer, "found symmetry: ");
+  for (auto var : sym)
+  {
+    write_literal(stdout_writer, var);
+  }
+  write_char(stdout_writer, '\n');
+}
+
+static void print_generator_line(const char *kind,
+                                 const std::vector<int> &generator)
+{
+  write_string(stdout_writer, kind);
+  print_generator(generator);
+  write_char(stdout_writer, '\n');
+}
+
+// In streaming mode every symmetry is written and flushed as soon as it is
+// confirmed, with '-b' as its breaking clauses but without the header,
+// which needs the final counts.  A summary line follows at the end.
+
+static void stream_lex_leader(const std::vector<int> &generator)
+{
+  std::vector<int> positions = lex_leader_positions(generator);
+  size_t k = positions.size() / 2;
+  if (!k)
+    return;
+  streamed_clauses += 3 * k - 2;
+  print_lex_leader(stdout_writer, positions);
+}
+
+static void stream_symmetry(const std::vector<int> &sym)
+{
+  if (breaking_clauses)
+  {
+    for (size_t i = 0; i + 1 < sym.size(); i++)
+      stream_lex_leader(row_swap({sym[i]}, {sym[i + 1]}));
+  }
+  else
+    print_symmetry(sym);
+  flush_writer(stdout_writer);
+}
+
+static void stream_generator(const std::vector<int> &generator, bool row)
+{
+  if (breaking_clauses)
+    stream_lex_leader(generator);
+  else if (row)
+    print_generator_line("found row symmetry: ", generator);
+  else
+    print_generator_line("found generator: ", generator);
+  flush_writer(stdout_writer);
+}
+
+// Clear the state of the last instance but keep its memory.
+
+static void reset(void)
+{
+  reset_formula(formula);
+  reset_search(search);
+  aux_variables = 0;
+  streamed_clauses = 0;
+  stats = Statistics();
+  memory = Memory_usage();
+  profile.clear();
+}
+
+static void release(void)
+{
+  release_formula(formula);
+  close_perf_counters();
+  delete_writer(stdout_writer);
+}
+
+// Find and print the symmetries of the parsed formula.
+
+static void analyze(void)
+{
+  if (fingerprinting)
+  {
+    Phase_scope scope(FILTER);
+    write_string(stdout_writer, "fingerprint: ");
+    write_string(stdout_writer, fingerprint(formula).c_str());
+    write_char(stdout_writer, '\n');
+    return;
+  }
+
+  start_search(search);
+
+  if (variable_sorting || anytime_limits(search))
+  {
+    sort_variables(search);
+  }
+
+  if (rows || automorphisms || breaking_clauses)
+  {
+    init_permutation(search);
+  }
+
+  const size_t exhaustive_pairs = search.exhaustive_pairs;
+  if (lsh)
+  {
+    find_lsh_symmetries(search);
+    verbose("lsh proposed %zu candidate pairs", search.lsh_candidates);
+    if (search.lsh_limited)
+      verbose("lsh paired %zu oversized buckets only within windows of %zu",
+              search.lsh_limited, lsh_window);
+    message("lsh checked %zu of %zu pairs", search.checked_pairs,
+            exhaustive_pairs);
+  }
+  else
+  {
+    find_symmetries(search);
+    verbose("checked %zu of %zu pairs", search.checked_pairs,
+            exhaustive_pairs);
+  }
+
+  if (rows)
+  {
+    find_row_symmetries(search);
+    message("row groups found: %zu", search.row_groups);
+  }
+
+  if (automorphisms)
+  {
+    find_automorphisms(search);
+    verbose("automorphism search depth %zu", search.aut_depth);
+    message("automorphism search: %zu nodes, %zu generators%s",
+            search.aut_nodes, search.aut_generators.size(),
+            search.aut_incomplete ? " (incomplete)" : "");
+  }
+
+  Phase_scope scope(OUTPUT);
+  const auto &symmetries = search.symmetries;
+  const size_t generators =
+      search.generators.size() + search.aut_generators.size();
+  int n_sym = 0;
+  for (auto &sym : symmetries)
+  {
+    n_sym += sym.size() * (sym.size() - 1) / 2;
+  }
+  message("symmetries found: %d", n_sym);
+
+  if (groups)
+  {
+    message("groups found: %d", symmetries.size());
+  }
+
+  // The completeness flag is printed whenever detection could have been
+  // stopped early, as a comment if the output is a formula.
+
+  if (search.incomplete)
+    message("detection stopped by %s after %zu of %zu pairs",
+            search.incomplete, search.checked_pairs, exhaustive_pairs);
+  const char *status =
+      search.incomplete || search.aut_incomplete ? "incomplete" : "complete";
+  if (streaming)
+  {
+    if (breaking_clauses)
+      write_format(stdout_writer,
+                   "c summary: %d symmetries, %zu generators, "
+                   "%zu breaking clauses, %d variables, %s\n",
+                   n_sym, generators, streamed_clauses,
+                   formula.variables + aux_variables, status);
+    else
+      write_format(stdout_writer,
+                   "summary: %d symmetries, %zu generators, %s\n", n_sym,
+                   generators, status);
+    return;
+  }
+
+  if (anytime_limits(search) || search.incomplete || interrupted)
+  {
+    if (breaking_clauses && !output_name)
+      write_string(stdout_writer, "c ");
+    write_format(stdout_writer, "status: %s\n", status);
+  }
+
+  if (breaking_clauses)
+  {
+    if (output_name)
+    {
+      Writer out = {-1, 0, 0, 0, 0, false, 0, 0};
+      out.fd = open(output_name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+      if (out.fd < 0)
+        die("could not open and write '%s'", output_name);
+      message("writing augmented formula to '%s'", output_name);
+      print_breaking_clauses(out, true);
+      delete_writer(out);
+      if (close(out.fd))
+        die("could not write '%s'", output_name);
     }
-    if (!found)
+    else
     {
-      return false;
+      print_breaking_clauses(stdout_writer, false);
     }
+    return;
   }
-  return true;
+
+  for (auto &sym : symmetries)
+    print_symmetry(sym);
+
+  for (auto &generator : search.generators)
+    print_generator_line("found row symmetry: ", generator);
+
+  for (auto &generator : search.aut_generators)
+    print_generator_line("found generator: ", generator);
+}
+
+static Batch batch_instances; // See 'batch.hpp'.
+
+// Every option which changes the printed result is part of the key.
+
+static std::string cache_options(void)
+{
+  char buffer[256];
+  snprintf(buffer, sizeof buffer,
+           "two_symmetry 2 s%d g%d b%d p%d r%d a%d n%d t%d l%d %d %d x%d v%d f%d"
+           " T%d B%d S%d",
+           variable_sorting, groups, breaking_clauses, phase, rows,
+           automorphisms, aut_node_limit, aut_time_limit, lsh, lsh_bands,
+           lsh_rows, lex_prefix, verbosity, fingerprinting, time_limit,
+           pair_budget, streaming);
+  return buffer;
+}
+
+static Run_info run_info(void)
+{
+  return {"two_symmetry", file_name, formula.variables,
+          formula.clauses.size(), search.checked_pairs,
+          symmetries_found(search), false};
+}
+
+// On a cache hit 'run' holds the numbers stored with the result and there
+// is no profile, since nothing was checked.
+
+static void report_statistics(const Run_info &run)
+{
+  if (statistics)
+    print_statistics(stdout_writer, run);
+  if (profile_top && run.cache_hit)
+    write_string(stdout_writer, "c\nc profile skipped (cache hit)\n");
+  else if (profile_top)
+    print_profile(stdout_writer);
+  if (stats_json && !append_json_statistics(stats_json, run))
+    instance_error("error: could not append statistics to '%s'", stats_json);
+}
+
+// Process the instance read from 'file' and reset the state afterwards.
+
+static bool process_file_untraced(void)
+{
+  search.formula = &formula;
+  search.options = &options;
+  search.start_time = wall_clock_time();
+  message("reading from '%s'", file_name);
+  std::string key, result;
+  if (cache_dir && !output_name)
+    key = cache_key(file, cache_options());
+  Run_info cached = run_info();
+  FILE *entry = key.empty() ? 0 : lookup_cache(cache_dir, key, cached);
+  if (entry)
+  {
+    copy_cache(entry, stdout_writer);
+    if (close_file)
+      fclose(file);
+    report_statistics(cached);
+    release_writer(stdout_writer);
+    reset();
+    return true;
+  }
+  if (!key.empty())
+  {
+    flush_writer(stdout_writer);
+    stdout_writer.copy = &result;
+  }
+  bool ok = true;
+  try
+  {
+    parse();
+    build_index(formula);
+    if (statistics || stats_json)
+      account_memory(formula);
+    analyze();
+    if (statistics || stats_json)
+      account_memory(formula), account_memory(search);
+    Phase_scope scope(OUTPUT);
+    flush_writer(stdout_writer);
+  }
+  catch (Skip_instance &)
+  {
+    if (close_file)
+      fclose(file);
+    ok = false;
+  }
+  stdout_writer.copy = 0;
+  if (ok && !key.empty() && !search.incomplete && !search.aut_incomplete)
+    store_cache(cache_dir, key, run_info(), result);
+  if (ok)
+    report_statistics(run_info());
+  release_writer(stdout_writer);
+  reset();
+  return ok;
+}
+
+static bool process_file(void)
+{
+  double start = trace_path ? trace_clock() : 0;
+  bool ok = process_file_untraced();
+  if (trace_path)
+    add_trace_event(file_name, "instance", start, trace_clock() - start);
+  return ok;
+}
+
+static bool process_instance(const char *path)
+{
+  file_name = path;
+  if (!(file = fopen(file_name, "r")))
+  {
+    instance_error("error: could not open and read '%s'", path);
+    release_writer(stdout_writer);
+    return false;
+  }
+  close_file = true;
+  return process_file();
+}
+
+static int run_batch(void)
+{
+  double start = wall_clock_time();
+  size_t workers = run_batch_workers(batch_instances, threads,
+                                     process_instance, release, &interrupted);
+  size_t failed = batch_instances.failed;
+  if (interrupted)
+    message("interrupted, remaining instances skipped");
+  message("batch of %zu instances (%zu failed) on %zu threads",
+          batch_instances.files.size(), failed, workers);
+  message("%.2f seconds wall-clock time, %.2f seconds process time",
+          wall_clock_time() - start, process_time());
+  if (trace_path && !write_trace())
+    die("could not write trace '%s'", trace_path);
+  flush_writer(stdout_writer);
+  return failed ? 1 : 0;
+}
+
+// The daemon listens on a Unix socket and serves one request per
+// connection.  The first line of a request is one of
+//
+//   path <file>  detect symmetries of the CNF in '<file>'
+//   cnf          detect symmetries of the CNF following this line (up to
+//                the end of the stream, i.e., the client shuts down writing)
+//   stats        print number of requests, latency and queue depth
+//   quit         stop the daemon
+//
+// and the response is the output of a single run on that CNF.  Accepted
+// connections are queued for a pool of worker threads, which keep their
+// thread local memory warm from one request to the next.
+//
+// The socket is created accessible only by the user running the daemon.
+// Reads and writes on a connection time out after 'request_timeout'
+// seconds without progress, thus a stalled client fails its request
+// instead of blocking a worker forever.
+
+struct Request
+{
+  int fd;
+  double accepted; // Wall-clock time of 'accept'.
+};
+
+static std::deque<Request> requests;
+static std::mutex queue_lock;
+static std::condition_variable queue_changed;
+static bool stopping;
+static int server = -1;
+
+static const int request_timeout = 10; // seconds
+
+static std::mutex stats_lock;
+static size_t served, failed_requests, busy_workers, max_queued;
+static double sum_latency, max_latency;
+
+// The reply to 'stats' is written to the client even with '-q'.
+
+static void print_daemon_stats(void)
+{
+  size_t queued;
+  {
+    std::lock_guard<std::mutex> lock(queue_lock);
+    queued = requests.size();
+  }
+  std::lock_guard<std::mutex> lock(stats_lock);
+  Writer &w = stdout_writer;
+  write_format(w, "c requests served: %zu (%zu failed)\n", served,
+               failed_requests);
+  write_format(w, "c queue depth: %zu (maximum %zu)\n", queued, max_queued);
+  write_format(w, "c busy workers: %zu of %d\n", busy_workers, threads);
+  write_format(w, "c average latency: %.3f ms\n",
+               served ? 1e3 * sum_latency / served : 0);
+  write_format(w, "c maximum latency: %.3f ms\n", 1e3 * max_latency);
 }
 
-void sort_variables()
+static void stop_daemon(void)
 {
-  std::sort(sorted_variables, sorted_variables + variables, [](int i, int j)
-            { return matrix[i].size() < matrix[j].size() || 
-                    (matrix[i].size() == matrix[j].size() && 
-                     matrix[-i].size() < matrix[-j].size()); });
+  std::lock_guard<std::mutex> lock(queue_lock);
+  stopping = true;
+  shutdown(server, SHUT_RDWR); // Wakes up 'accept'.
+  queue_changed.notify_all();
 }
 
-void find_symmetries()
+static void serve_request(Request &request)
 {
-  int checked_pairs = 0;
-  for (int i = 0; i < variables; i++)
+  stdout_writer.fd = request.fd;
+  FILE *in = fdopen(dup(request.fd), "r");
+  char *line = 0;
+  size_t size = 0;
+  ssize_t len = in ? getline(&line, &size, in) : -1;
+  while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+    line[--len] = 0;
+  bool ok = true, counted = true;
+  if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    instance_error("error: request timed out"), ok = false;
+  else if (len < 0)
+    ok = false;
+  else if (!strcmp(line, "stats"))
+    print_daemon_stats(), counted = false;
+  else if (!strcmp(line, "quit"))
+    stop_daemon(), counted = false;
+  else if (!strncmp(line, "path ", 5))
+    ok = process_instance(line + 5);
+  else if (!strcmp(line, "cnf"))
+  {
+    file_name = "<socket>";
+    file = in;
+    close_file = false;
+    ok = process_file();
+  }
+  else
+  {
+    instance_error("error: invalid request '%s'", line);
+    ok = false;
+  }
+
+  // Counted before the reply is completed, thus a client sending 'stats'
+  // after reading a reply sees its request.
+
+  if (counted)
   {
-    int var1 = sorted_variables[i];
-    std::vector<int> group = {var1};
-    for (int j = i + 1; j < variables; j++)
+    double latency = wall_clock_time() - request.accepted;
+    std::lock_guard<std::mutex> lock(stats_lock);
+    served++;
+    failed_requests += !ok;
+    sum_latency += latency;
+    max_latency = std::max(max_latency, latency);
+  }
+  flush_writer(stdout_writer);
+  free(line);
+  if (in)
+    fclose(in);
+  close(request.fd);
+}
+
+static void daemon_worker(void)
+{
+  stdout_writer.keep_going = true;
+  for (;;)
+  {
+    Request request;
     {
-      checked_pairs++;
-      int var2 = sorted_variables[j];
-      if (matrix[var1].size() != 0 && 
-          matrix[var1].size() == matrix[var2].size() && 
-          matrix[-var1].size() == matrix[-var2].size())
-      {
-        if (check_symmetry(var1, var2) && check_symmetry(-var1, -var2))
-        {
-          if (groups) 
-          {
-            group.push_back(var2);
-            int tmp = sorted_variables[i+1];
-            sorted_variables[i+1] = sorted_variables[j];
-            sorted_variables[j] = tmp;
-            i++;
-          } else {
-            symmetries.push_back({var1, var2});
-          }
-        }
-      }
-      else if(variable_sorting)
-      {
+      std::unique_lock<std::mutex> lock(queue_lock);
+      queue_changed.wait(lock, [] { return stopping || !requests.empty(); });
+      if (requests.empty())
         break;
-      }
+      request = requests.front();
+      requests.pop_front();
     }
-    if (group.size() > 1) {
-      symmetries.push_back(group);
+    {
+      std::lock_guard<std::mutex> lock(stats_lock);
+      busy_workers++;
+    }
+    serve_request(request);
+    {
+      std::lock_guard<std::mutex> lock(stats_lock);
+      busy_workers--;
     }
   }
+  release();
 }
 
-static void delete_clause(Clause *c)
+static int run_daemon(void)
 {
-  delete[] c;
+  signal(SIGPIPE, SIG_IGN);
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof address);
+  address.sun_family = AF_UNIX;
+  if (strlen(daemon_path) >= sizeof address.sun_path)
+    die("socket path '%s' too long", daemon_path);
+  strcpy(address.sun_path, daemon_path);
+  if ((server = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+    die("could not create socket");
+  unlink(daemon_path);
+  mode_t mask = umask(077); // Before any other thread is started.
+  int bound = bind(server, (struct sockaddr *)&address, sizeof address);
+  umask(mask);
+  if (bound || listen(server, 128))
+    die("could not listen on '%s'", daemon_path);
+  message("listening on '%s' with %d workers", daemon_path, threads);
+  flush_writer(stdout_writer);
+
+  std::vector<std::thread> pool;
+  for (int i = 0; i < threads; i++)
+    pool.emplace_back(daemon_worker);
+  for (;;)
+  {
+    int fd = accept(server, 0, 0);
+    std::lock_guard<std::mutex> lock(queue_lock);
+    if (stopping)
+    {
+      if (fd >= 0)
+        close(fd);
+      break;
+    }
+    if (fd < 0)
+    {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      die("accept failed on '%s'", daemon_path);
+    }
+    struct timeval timeout = {request_timeout, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof timeout);
+    requests.push_back({fd, wall_clock_time()});
+    max_queued = std::max(max_queued, requests.size());
+    queue_changed.notify_one();
+  }
+  for (auto &worker : pool)
+    worker.join();
+  close(server);
+  unlink(daemon_path);
+  message("served %zu requests", served);
+  if (trace_path && !write_trace())
+    die("could not write trace '%s'", trace_path);
+  flush_writer(stdout_writer);
+  return 0;
 }
 
-static void release(void)
+// The first 'SIGINT' stops detection and prints what was found so far, a
+// second one terminates as usual.
+
+static void interrupt(int sig)
 {
-  for (auto c : clauses)
-    delete_clause(c);
-  matrix -= variables;
-  delete[] matrix;
+  interrupted = 1;
+  signal(sig, SIG_DFL);
 }
 
 int main(int argc, char **argv)
 {
+  std::vector<const char *> paths;
   for (int i = 1; i != argc; i++)
   {
     const char *arg = argv[i];
@@ -392,66 +1091,156 @@ int main(int argc, char **argv)
       groups = true;
     else if (!strcmp(arg, "-b") || !strcmp(arg, "--breaking-clauses"))
       breaking_clauses = true;
-    else if (arg[0] == '-')
+    else if (parse_int_option(arg, "--lex-prefix", &lex_prefix, 0))
+      breaking_clauses = true;
+    else if (!strcmp(arg, "-o"))
+    {
+      if (++i == argc)
+        die("argument to '-o' missing (try '-h')");
+      output_name = argv[i];
+      breaking_clauses = true;
+    }
+    else if (!strcmp(arg, "-r") || !strcmp(arg, "--rows"))
+      rows = true;
+    else if (!strcmp(arg, "-a") || !strcmp(arg, "--automorphisms"))
+      automorphisms = true;
+    else if (parse_int_option(arg, "--aut-nodes", &aut_node_limit, 0))
+      automorphisms = true;
+    else if (parse_int_option(arg, "--aut-time", &aut_time_limit, 0))
+      automorphisms = true;
+    else if (!strcmp(arg, "-p") || !strcmp(arg, "--phase"))
+      phase = true;
+    else if (!strcmp(arg, "--lsh"))
+      lsh = true;
+    else if (parse_int_option(arg, "--lsh-bands", &lsh_bands, 1))
+      lsh = true;
+    else if (parse_int_option(arg, "--lsh-rows", &lsh_rows, 1))
+      lsh = true;
+    else if (parse_int_option(arg, "--time-limit", &time_limit, 0))
+      continue;
+    else if (parse_int_option(arg, "--pair-budget", &pair_budget, 0))
+      continue;
+    else if (!strcmp(arg, "--fingerprint"))
+      fingerprinting = true;
+    else if (!strcmp(arg, "--stream"))
+      streaming = true;
+    else if (!strcmp(arg, "--batch"))
+      batch = true;
+    else if (!strcmp(arg, "--cache"))
+    {
+      if (++i == argc)
+        die("argument to '--cache' missing (try '-h')");
+      cache_dir = argv[i];
+    }
+    else if (!strcmp(arg, "--stats"))
+      statistics = true;
+    else if (!strcmp(arg, "--perf"))
+      statistics = perf_counting = true;
+    else if (!strcmp(arg, "--stats-json"))
+    {
+      if (++i == argc)
+        die("argument to '--stats-json' missing (try '-h')");
+      stats_json = argv[i];
+    }
+    else if (parse_int_option(arg, "--profile", &profile_top, 1))
+      continue;
+    else if (parse_int_option(arg, "--memory-limit", &memory_limit, 0))
+      continue;
+    else if (!strcmp(arg, "--trace"))
+    {
+      if (++i == argc)
+        die("argument to '--trace' missing (try '-h')");
+      trace_path = argv[i];
+    }
+    else if (parse_int_option(arg, "--trace-threshold", &trace_threshold, 0))
+      continue;
+    else if (!strcmp(arg, "--daemon"))
+    {
+      if (++i == argc)
+        die("argument to '--daemon' missing (try '-h')");
+      daemon_path = argv[i];
+    }
+    else if (parse_int_option(arg, "--threads", &threads, 1))
+      batch = true;
+    else if (arg[0] == '-' && arg[1])
       die("invalid option '%s' (try '-h')", arg);
-    else if (file_name)
-      die("too many arguments '%s' and '%s' (try '-h')", file_name, arg);
     else
-      file_name = arg;
-  }
-
-  if (!file_name)
-  {
-    file_name = "<stdin>";
-    assert(!close_file);
-    file = stdin;
+      paths.push_back(arg);
   }
-  else if (!(file = fopen(file_name, "r")))
-    die("could not open and read '%s'", file_name);
-  else
-    close_file = true;
 
-  message("reading from '%s'", file_name);
+  if (cache_dir && mkdir(cache_dir, 0777) && errno != EEXIST)
+    die("could not create cache directory '%s'", cache_dir);
 
-  parse();
+  if (streaming && output_name)
+    die("'--stream' can not be combined with '-o'");
 
-  if (variable_sorting)
+  options.sorting = variable_sorting;
+  options.groups = groups;
+  options.phase = phase;
+  options.lsh = lsh;
+  options.lsh_bands = lsh_bands;
+  options.lsh_rows = lsh_rows;
+  options.time_limit = time_limit;
+  options.pair_budget = pair_budget;
+  options.interrupted = &interrupted;
+  options.aut_node_limit = aut_node_limit;
+  options.aut_time_limit = aut_time_limit;
+  options.account_memory = statistics || stats_json;
+  if (streaming)
   {
-    sort_variables();
+    options.found_symmetry = stream_symmetry;
+    options.found_generator = stream_generator;
   }
 
-  find_symmetries();
-
-  int n_sym = 0;
-  for (auto sym : symmetries)
+  if (daemon_path)
   {
-    n_sym += sym.size() * (sym.size() - 1) / 2;
+    if (output_name)
+      die("'-o' can not be combined with '--daemon'");
+    if (!paths.empty())
+      die("unexpected argument '%s' to '--daemon'", paths[0]);
+    batch = true;
+    return run_daemon();
   }
-  message("symmetries found: %d", n_sym);
 
-  if (groups)
+  signal(SIGINT, interrupt);
+
+  if (batch)
   {
-    message("groups found: %d", symmetries.size());
+    if (output_name)
+      die("'-o' can not be combined with '--batch'");
+    if (streaming) // Would keep the shared output locked per instance.
+      die("'--stream' can not be combined with '--batch'");
+    if (paths.empty())
+      paths.push_back("-");
+    for (auto path : paths)
+      if (const char *failed = collect_batch_files(batch_instances, path))
+        die("could not %s '%s'", failed, path);
+    return run_batch();
   }
 
-  for (auto sym : symmetries)
+  if (paths.size() > 1)
+    die("too many arguments '%s' and '%s' (try '-h')", paths[0], paths[1]);
+
+  if (paths.empty())
   {
-    if (!breaking_clauses) 
-    {
-      printf("found symmetry: ");
-      for (auto var : sym) 
-      {
-        printf("%d ", var);
-      }
-      printf("\n");
-    }
-    if (breaking_clauses)
-    {
-      for(int i = 0; i < sym.size() - 1; i++)
-      {
-        printf("-%d %d 0 \n", sym[i], sym[i+1]);
-      }
-    }
+    file_name = "<stdin>";
+    assert(!close_file);
+    file = stdin;
   }
+  else if (!(file = fopen(file_name = paths[0], "r")))
+    die("could not open and read '%s'", file_name);
+  else
+    close_file = true;
+
+  // The output file is truncated before the input clauses are copied.
+
+  struct stat in, out;
+  if (output_name && !fstat(fileno(file), &in) && !stat(output_name, &out) &&
+      in.st_dev == out.st_dev && in.st_ino == out.st_ino)
+    die("output '%s' is the input file '%s'", output_name, file_name);
+
+  process_file();
   release();
+  if (trace_path && !write_trace())
+    die("could not write trace '%s'", trace_path);
 }